@@ -612,6 +612,7 @@ void cls_alg::tune_smartmask()
                       cam->imgs.common_buffer, 255);
     erode5(smartmask_final, cam->imgs.width, cam->imgs.height,
                       cam->imgs.common_buffer, 255);
+    smartmask_gen++;
     smartmask_count = 5 * cam->lastrate * (11 - cam->cfg->smart_mask_speed);
 }
 
@@ -1228,6 +1229,7 @@ cls_alg::cls_alg(cls_camera *p_cam)
 
     memset(smartmask, 0, (uint)cam->imgs.motionsize);
     memset(smartmask_final, 255, (uint)cam->imgs.motionsize);
+    smartmask_gen = 0;
     memset(smartmask_buffer, 0, (uint)cam->imgs.motionsize * sizeof(*smartmask_buffer));
 
     for (i = 0; i < THRESHOLD_TUNE_LENGTH - 1; i++) {
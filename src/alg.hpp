@@ -33,6 +33,7 @@
             void stddev();
             void location();
             u_char  *smartmask_final;
+            int     smartmask_gen;      /* Incremented when smartmask_final changes */
         private:
             cls_camera *cam;
             int     smartmask_count;
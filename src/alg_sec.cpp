@@ -21,6 +21,7 @@
 #include "camera.hpp"
 #include "conf.hpp"
 #include "logger.hpp"
+#include "evwait.hpp"
 #include "alg_sec.hpp"
 
 #ifdef HAVE_OPENCV
@@ -110,6 +111,9 @@ void cls_algsec::label_image(Mat &mat_dst
     std::vector<uchar> buff;
     std::vector<int> param(2);
     char wstr[10];
+    cv::Size whole_sz;
+    cv::Point ofs;
+    ctx_coord box;
 
     try {
         detected = false;
@@ -132,6 +136,26 @@ void cls_algsec::label_image(Mat &mat_dst
             }
         }
 
+        /* Keep the boxes in image_norm pixels for the encoders */
+        mat_dst.locateROI(whole_sz, ofs);
+        pthread_mutex_lock(&mutex);
+            boxes.clear();
+            for (indx0=0; indx0<fltr_pos.size(); indx0++) {
+                box.minx = fltr_pos[indx0].x + ofs.x;
+                box.miny = fltr_pos[indx0].y + ofs.y;
+                box.maxx = MIN(box.minx + fltr_pos[indx0].width, width) - 1;
+                box.maxy = MIN(box.miny + fltr_pos[indx0].height, height) - 1;
+                box.width = box.maxx - box.minx + 1;
+                box.height = box.maxy - box.miny + 1;
+                box.x = box.minx + (box.width / 2);
+                box.y = box.miny + (box.height / 2);
+                box.stddev_x = 0;
+                box.stddev_y = 0;
+                box.stddev_xy = 0;
+                boxes.push_back(box);
+            }
+        pthread_mutex_unlock(&mutex);
+
         if (detected) {
             for (indx0=0; indx0<fltr_pos.size(); indx0++) {
                 Rect r = fltr_pos[indx0];
@@ -159,16 +183,41 @@ void cls_algsec::label_image(Mat &mat_dst
 void cls_algsec::label_image(Mat &mat_dst, double confidence, Point classIdPoint)
 {
     std::string label;
+    ctx_coord box;
+    Size whole_sz;
+    Point ofs;
 
     try {
         detected = false;
         debug_notice(mat_dst, detected);
 
+        pthread_mutex_lock(&mutex);
+            boxes.clear();
+        pthread_mutex_unlock(&mutex);
+
         if (confidence < threshold) {
             return;
         }
 
         detected = true;
+
+        /* The whole image classified is the region for the encoders */
+        mat_dst.locateROI(whole_sz, ofs);
+        box.minx = ofs.x;
+        box.miny = ofs.y;
+        box.maxx = MIN(box.minx + mat_dst.cols, width) - 1;
+        box.maxy = MIN(box.miny + mat_dst.rows, height) - 1;
+        box.width = box.maxx - box.minx + 1;
+        box.height = box.maxy - box.miny + 1;
+        box.x = box.minx + (box.width / 2);
+        box.y = box.miny + (box.height / 2);
+        box.stddev_x = 0;
+        box.stddev_y = 0;
+        box.stddev_xy = 0;
+        pthread_mutex_lock(&mutex);
+            boxes.push_back(box);
+        pthread_mutex_unlock(&mutex);
+
         label = format("%s: %.4f"
             , (dnn_classes.empty() ?
                 format("Class #%d", classIdPoint.x).c_str() :
@@ -592,8 +641,6 @@ void cls_algsec::load_params()
 /**Detection thread processing loop */
 void cls_algsec::handler()
 {
-    long interval;
-
     mythreadname_set("cv",cam->cfg->device_id, cam->cfg->device_name.c_str());
 
     MOTION_LOG(INF, TYPE_ALL, NO_ERRNO,_("Secondary detection starting."));
@@ -603,7 +650,6 @@ void cls_algsec::handler()
 
     load_params();
 
-    interval = 1000000L / cfg_framerate;
     is_started = true;
     while ((handler_stop == false) && (method != "none")) {
         if (in_process){
@@ -616,7 +662,8 @@ void cls_algsec::handler()
             }
             in_process = false;
         } else {
-            SLEEP(0,interval)
+            /* Woken by detect when a new image is ready or by shutdown */
+            evwait->wait_until(nullptr);
         }
     }
     is_started = false;
@@ -657,6 +704,7 @@ void cls_algsec::handler_shutdown()
 
     if (handler_running == true) {
         handler_stop = true;
+        evwait->wake();
         waitcnt = 0;
         while ((handler_running == true) && (waitcnt < cam->cfg->watchdog_tmo)){
             SLEEP(1,0)
@@ -723,6 +771,7 @@ void cls_algsec::detect()
 
                 /*Set the bool to detect on the new image and reset interval */
                 in_process = true;
+                evwait->wake();
                 frame_cnt = frame_interval;
                 if (frame_missed >10){
                     if (too_slow == 0) {
@@ -748,6 +797,34 @@ void cls_algsec::detect()
     #endif
 }
 
+/* Whether detect may take a copy of the current image */
+bool cls_algsec::image_wanted()
+{
+    #ifdef HAVE_OPENCV
+        if ((method == "none") || (is_started == false)) {
+            return false;
+        }
+        return (frame_cnt <= 1);
+    #else
+        return false;
+    #endif
+}
+
+/* Append the objects found by the last detection */
+void cls_algsec::boxes_get(std::vector<ctx_coord> &dst)
+{
+    #ifdef HAVE_OPENCV
+        if ((method == "none") || (detected == false)) {
+            return;
+        }
+        pthread_mutex_lock(&mutex);
+            dst.insert(dst.end(), boxes.begin(), boxes.end());
+        pthread_mutex_unlock(&mutex);
+    #else
+        (void)dst;
+    #endif
+}
+
 cls_algsec::cls_algsec(cls_camera *p_cam)
 {
     #ifdef HAVE_OPENCV
@@ -759,6 +836,7 @@ cls_algsec::cls_algsec(cls_camera *p_cam)
         method = "none";
         is_started = false;
         pthread_mutex_init(&mutex, NULL);
+        evwait = new cls_evwait();
         handler_startup();
     #else
         (void)p_cam;
@@ -770,6 +848,7 @@ cls_algsec::~cls_algsec()
     #ifdef HAVE_OPENCV
         handler_shutdown();
         pthread_mutex_destroy(&mutex);
+        mydelete(evwait);
     #endif
 }
 
@@ -39,6 +39,8 @@ class cls_algsec {
         ~cls_algsec();
 
         void        detect();
+        void        boxes_get(std::vector<ctx_coord> &dst);
+        bool        image_wanted();
         bool        detected;
 
         std::string method;
@@ -52,6 +54,7 @@ class cls_algsec {
     private:
         #ifdef HAVE_OPENCV
             cls_camera      *cam;
+            cls_evwait      *evwait;
             bool            in_process;
             bool            is_started;
             bool            first_pass;
@@ -89,6 +92,7 @@ class cls_algsec {
 
             std::string                 config;
             ctx_params                  *params;
+            std::vector<ctx_coord>      boxes;      /* Objects of the last detection */
 
             std::string                 model_file;
             int                         frame_interval;
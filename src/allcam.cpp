@@ -21,6 +21,7 @@
 #include "util.hpp"
 #include "conf.hpp"
 #include "logger.hpp"
+#include "evwait.hpp"
 #include "allcam.hpp"
 #include "camera.hpp"
 #include "jpegutils.hpp"
@@ -702,29 +703,45 @@ void cls_allcam::getsizes()
 
 }
 
+void cls_allcam::wake()
+{
+    evwait->wake();
+}
+
 void cls_allcam::timing()
 {
     struct timespec ts2;
-    int64_t sleeptm;
 
     if ((restart == true) || (handler_stop == true)) {
         return;
     }
 
-    clock_gettime(CLOCK_MONOTONIC, &ts2);
+    /* No one is watching so wait for a connection or shutdown to wake us */
+    if ((stream.norm.all_cnct == 0) && (stream.sub.all_cnct == 0) &&
+        (stream.motion.all_cnct == 0) && (stream.source.all_cnct == 0) &&
+        (stream.secondary.all_cnct == 0)) {
+        evwait->wait_until(nullptr);
+        clock_gettime(CLOCK_MONOTONIC, &curr_ts);
+        return;
+    }
 
-    sleeptm = ((1000000L / app->cfg->stream_maxrate) -
-          (1000000L * (ts2.tv_sec - curr_ts.tv_sec)) -
-          ((ts2.tv_nsec - curr_ts.tv_nsec)/1000))*1000;
+    curr_ts.tv_nsec += (1000000000L / app->cfg->stream_maxrate);
+    while (curr_ts.tv_nsec >= 1000000000L) {
+        curr_ts.tv_sec++;
+        curr_ts.tv_nsec -= 1000000000L;
+    }
 
-    /* If over 1 second, just do one*/
-    if (sleeptm > 999999999L) {
-        SLEEP(1, 0);
-    } else if (sleeptm > 0) {
-        SLEEP(0, sleeptm);
+    /* When behind, restart the pacing from now instead of bursting */
+    clock_gettime(CLOCK_MONOTONIC, &ts2);
+    if ((curr_ts.tv_sec < ts2.tv_sec) ||
+        ((curr_ts.tv_sec == ts2.tv_sec) && (curr_ts.tv_nsec < ts2.tv_nsec))) {
+        curr_ts = ts2;
+        return;
     }
 
-    clock_gettime(CLOCK_MONOTONIC, &curr_ts);
+    if (evwait->wait_until(&curr_ts) == true) {
+        clock_gettime(CLOCK_MONOTONIC, &curr_ts);
+    }
 
 }
 
@@ -789,6 +806,7 @@ void cls_allcam::handler_shutdown()
 
     if (handler_running == true) {
         handler_stop = true;
+        evwait->wake();
         waitcnt = 0;
         while ((handler_running == true) && (waitcnt < app->cfg->watchdog_tmo)){
             SLEEP(1,0)
@@ -844,6 +862,7 @@ cls_allcam::cls_allcam(cls_motapp *p_app)
     clock_gettime(CLOCK_MONOTONIC, &curr_ts);
     active_cnt    = 0;
     active_cam.clear();
+    evwait = new cls_evwait();
 
     handler_startup();
 }
@@ -854,4 +873,5 @@ cls_allcam::~cls_allcam()
     handler_shutdown();
     pthread_mutex_destroy(&stream.mutex);
     stream_free();
+    mydelete(evwait);
 }
@@ -28,6 +28,7 @@ class cls_allcam {
         bool            handler_running;
         pthread_t       handler_thread;
         void            handler();
+        void            wake();
         ctx_stream      stream;
         ctx_all_sizes   all_sizes;
 
@@ -36,13 +37,14 @@ class cls_allcam {
 
     private:
         cls_motapp          *app;
+        cls_evwait          *evwait;
 
         std::vector<cls_camera*>    active_cam;
         int active_cnt;
         int watchdog;
         int max_col;
         int max_row;
-        struct timespec     curr_ts;
+        struct timespec     curr_ts;    /* Deadline for the next image */
 
         void handler_startup();
         void handler_shutdown();
@@ -35,6 +35,8 @@
 #include "dbse.hpp"
 #include "draw.hpp"
 #include "webu_getimg.hpp"
+#include "storage.hpp"
+#include "profile.hpp"
 
 static void *camera_handler(void *arg)
 {
@@ -58,8 +60,9 @@ void cls_camera::ring_resize()
 
     tmp =(ctx_image_data*) mymalloc((uint)new_size * sizeof(ctx_image_data));
 
+    /* Page aligned so capture devices can fill the slots directly */
     for(i = 0; i < new_size; i++) {
-        tmp[i].image_norm =(u_char*) mymalloc((uint)imgs.size_norm);
+        tmp[i].image_norm =(u_char*) mymalloc_page((uint)imgs.size_norm);
         memset(tmp[i].image_norm, 0x80, (uint)imgs.size_norm);
         if (imgs.size_high > 0) {
             tmp[i].image_high =(u_char*) mymalloc((uint)imgs.size_high);
@@ -128,10 +131,13 @@ void cls_camera::ring_process_debug()
 
 void cls_camera::ring_process_image()
 {
+    int64_t prof_ts;
+
     if (current_image->save_pic) {
         picture->process_norm();
     }
     if (current_image->save_movie) {
+        prof_ts = profile->now();
         if (movie_norm->put_image(current_image
                 , &current_image->imgts) == -1) {
             MOTION_LOG(ERR, TYPE_EVENTS, NO_ERRNO, _("Error encoding image"));
@@ -144,6 +150,7 @@ void cls_camera::ring_process_image()
                 , &current_image->imgts) == -1) {
             MOTION_LOG(ERR, TYPE_EVENTS, NO_ERRNO, _("Error encoding image"));
         }
+        profile->record(PROF_MOVIE, prof_ts);
     }
 }
 
@@ -210,18 +217,29 @@ void cls_camera::movie_start()
         movie_fps = lastrate;
     }
     movie_nbr++;
-    movie_norm->start();
+    movie_norm->event_start();
     movie_motion->start();
     movie_extpipe->start();
 }
 
 void cls_camera::movie_end()
 {
-    movie_norm->stop();
+    movie_norm->event_end();
     movie_motion->stop();
     movie_extpipe->stop();
 }
 
+/* Motion and secondary detection boxes of the image for the encoders */
+void cls_camera::roi_get(ctx_image_data *img_data, std::vector<ctx_coord> &dst)
+{
+    dst.clear();
+    if ((img_data->diffs > 0) && (img_data->location.width > 0) &&
+        (img_data->location.height > 0)) {
+        dst.push_back(img_data->location);
+    }
+    algsec->boxes_get(dst);
+}
+
 /* Process the motion detected items*/
 void cls_camera::detected_trigger()
 {
@@ -316,6 +334,60 @@ void cls_camera::detected()
     track_move();
 }
 
+/* Clear only the masked runs of the image */
+void cls_camera::mask_privacy_spans(u_char *image, ctx_mask_spans *spans, int size_y)
+{
+    u_char *image_u, *image_v;
+    int indx;
+
+    for (indx = 0; indx < spans->y_cnt; indx++) {
+        memset(image + spans->y[indx].offset, 0x00, (uint)spans->y[indx].length);
+    }
+
+    image_u = image + size_y;
+    image_v = image_u + (size_y / 4);
+    for (indx = 0; indx < spans->uv_cnt; indx++) {
+        memset(image_u + spans->uv[indx].offset, 0x80, (uint)spans->uv[indx].length);
+        memset(image_v + spans->uv[indx].offset, 0x80, (uint)spans->uv[indx].length);
+    }
+}
+
+/* Whether a consumer of this frame needs it without the privacy mask */
+bool cls_camera::virgin_wanted()
+{
+    if ((stream.source.jpg_cnct > 0) ||
+        (stream.source.ts_cnct > 0) ||
+        (stream.source.all_cnct > 0)) {
+        return true;
+    }
+    return algsec->image_wanted();
+}
+
+/*
+ * Set up the virgin and privacy masked variants of the captured image.
+ * Without a privacy mask both are the same so image_virgin refers to
+ * image_vprvcy.  With a mask the unmasked copy is only taken when the
+ * source stream or the secondary detection will read it.
+ */
+void cls_camera::image_variants()
+{
+    if (imgs.mask_privacy == NULL) {
+        imgs.image_virgin = imgs.image_vprvcy;
+    } else if (virgin_wanted()) {
+        memcpy(imgs.image_virgin_buf, current_image->image_norm
+            , (uint)imgs.size_norm);
+        imgs.image_virgin = imgs.image_virgin_buf;
+    } else {
+        imgs.image_virgin = imgs.image_vprvcy;
+    }
+
+    mask_privacy();
+
+    /* Also the image repeated when a frame is missed */
+    memcpy(imgs.image_vprvcy, current_image->image_norm
+        , (uint)imgs.size_norm);
+}
+
 /* Apply the privacy mask to image*/
 void cls_camera::mask_privacy()
 {
@@ -323,6 +395,17 @@ void cls_camera::mask_privacy()
         return;
     }
 
+    if ((imgs.privacy_spans.y != NULL) &&
+        ((imgs.size_high == 0) || (imgs.privacy_spans_high.y != NULL))) {
+        mask_privacy_spans(current_image->image_norm
+            , &imgs.privacy_spans, imgs.width * imgs.height);
+        if (imgs.size_high > 0) {
+            mask_privacy_spans(current_image->image_high
+                , &imgs.privacy_spans_high, imgs.width_high * imgs.height_high);
+        }
+        return;
+    }
+
     /*
     * This function uses long operations to process 4 (32 bit) or 8 (64 bit)
     * bytes at a time, providing a significant boost in performance.
@@ -592,8 +675,9 @@ void cls_camera::init_buffers()
     imgs.ref =(u_char*) mymalloc((uint)imgs.size_norm);
     imgs.image_motion.image_norm = (u_char*)mymalloc((uint)imgs.size_norm);
     imgs.ref_dyn =(int*) mymalloc((uint)imgs.motionsize * sizeof(*imgs.ref_dyn));
-    imgs.image_virgin =(u_char*) mymalloc((uint)imgs.size_norm);
+    imgs.image_virgin_buf =(u_char*) mymalloc((uint)imgs.size_norm);
     imgs.image_vprvcy = (u_char*)mymalloc((uint)imgs.size_norm);
+    imgs.image_virgin = imgs.image_vprvcy;
     imgs.labels =(int*)mymalloc((uint)imgs.motionsize * sizeof(*imgs.labels));
     imgs.labelsize =(int*) mymalloc((uint)(imgs.motionsize/2+1) * sizeof(*imgs.labelsize));
     imgs.image_preview.image_norm =(u_char*) mymalloc((uint)imgs.size_norm);
@@ -617,6 +701,10 @@ void cls_camera::init_values()
 
     clock_gettime(CLOCK_MONOTONIC, &frame_curr_ts);
     clock_gettime(CLOCK_MONOTONIC, &frame_last_ts);
+    memset(&frame_timing, 0, sizeof(frame_timing));
+    frame_timing.next_ts = frame_curr_ts;
+    frame_timing.fps_ts = frame_curr_ts;
+    frame_timing.fps = cfg->framerate;
 
     noise = cfg->noise_level;
     passflag = false;
@@ -694,13 +782,7 @@ void cls_camera::init_cam_start()
 /* initialize reference images*/
 void cls_camera::init_ref()
 {
-    memcpy(imgs.image_virgin, current_image->image_norm
-        , (uint)imgs.size_norm);
-
-    mask_privacy();
-
-    memcpy(imgs.image_vprvcy, current_image->image_norm
-        , (uint)imgs.size_norm);
+    image_variants();
 
     alg->ref_frame_reset();
 }
@@ -721,6 +803,7 @@ void cls_camera::cleanup()
         movie_end();
         app->dbse->exec(this, "", "event_end");
     }
+    movie_norm->stop();
 
     webu_getimg_deinit(this);
 
@@ -729,7 +812,8 @@ void cls_camera::cleanup()
     myfree(imgs.image_motion.image_norm);
     myfree(imgs.ref);
     myfree(imgs.ref_dyn);
-    myfree(imgs.image_virgin);
+    imgs.image_virgin = NULL;
+    myfree(imgs.image_virgin_buf);
     myfree(imgs.image_vprvcy);
     myfree(imgs.labels);
     myfree(imgs.labelsize);
@@ -738,6 +822,10 @@ void cls_camera::cleanup()
     myfree(imgs.mask_privacy_uv);
     myfree(imgs.mask_privacy_high);
     myfree(imgs.mask_privacy_high_uv);
+    myfree(imgs.privacy_spans.y);
+    myfree(imgs.privacy_spans.uv);
+    myfree(imgs.privacy_spans_high.y);
+    myfree(imgs.privacy_spans_high.uv);
     myfree(imgs.common_buffer);
     myfree(imgs.image_secondary);
     myfree(imgs.image_preview.image_norm);
@@ -839,6 +927,32 @@ void cls_camera::init_cleandir_default()
             ,_("Setting default clean directory duration value to 7."));
         cleandir->dur_val = 7;
     }
+
+    if (cleandir->max_size < 0) {
+        MOTION_LOG(ERR, TYPE_ALL, NO_ERRNO
+            ,_("Invalid clean directory max_size : %d")
+            ,cleandir->max_size);
+        cleandir->max_size = 0;
+    }
+    if ((cleandir->max_pct < 0) || (cleandir->max_pct > 99)) {
+        MOTION_LOG(ERR, TYPE_ALL, NO_ERRNO
+            ,_("Invalid clean directory max_pct : %d")
+            ,cleandir->max_pct);
+        cleandir->max_pct = 0;
+    }
+    if ((cleandir->threads < 1) || (cleandir->threads > 8)) {
+        MOTION_LOG(NTC, TYPE_ALL, NO_ERRNO
+            ,_("Setting clean directory threads to 2."));
+        cleandir->threads = 2;
+    }
+    if (cleandir->rate < 0) {
+        cleandir->rate = 0;
+    }
+    if ((cleandir->batch < 1) || (cleandir->batch > 5000)) {
+        MOTION_LOG(NTC, TYPE_ALL, NO_ERRNO
+            ,_("Setting clean directory batch to 250."));
+        cleandir->batch = 250;
+    }
 }
 
 void cls_camera::init_cleandir_runtime()
@@ -979,6 +1093,13 @@ void cls_camera::init_cleandir()
     cleandir->removedir = false;
     cleandir->dur_unit = "w";
     cleandir->dur_val = 2;
+    cleandir->max_size = 0;
+    cleandir->max_pct = 0;
+    cleandir->threads = 2;
+    cleandir->rate = 50;
+    cleandir->batch = 250;
+    cleandir->pct_retry = 0;
+    cleandir->warn_ts = 0;
 
     for (indx=0; indx<params->params_cnt; indx++) {
         pnm = params->params_array[indx].param_name;
@@ -1004,6 +1125,21 @@ void cls_camera::init_cleandir()
         if (pnm == "removedir") {
             cleandir->removedir = mtob(pvl);
         }
+        if (pnm == "max_size") {
+            cleandir->max_size = mtoi(pvl);
+        }
+        if (pnm == "max_pct") {
+            cleandir->max_pct = mtoi(pvl);
+        }
+        if (pnm == "threads") {
+            cleandir->threads = mtoi(pvl);
+        }
+        if (pnm == "rate") {
+            cleandir->rate = mtoi(pvl);
+        }
+        if (pnm == "batch") {
+            cleandir->batch = mtoi(pvl);
+        }
     }
     init_cleandir_default();
     init_cleandir_runtime();
@@ -1192,6 +1328,8 @@ void cls_camera::init()
 
     init_cleandir();
 
+    storage->init();
+
     init_schedule();
 
     init_areadetect();
@@ -1337,11 +1475,7 @@ int cls_camera::capture()
             }
         }
         missing_frame_counter = 0;
-        memcpy(imgs.image_virgin, current_image->image_norm
-            , (uint)imgs.size_norm);
-        mask_privacy();
-        memcpy(imgs.image_vprvcy, current_image->image_norm
-            , (uint)imgs.size_norm);
+        image_variants();
 
     } else {
         if (connectionlosttime.tv_sec == 0) {
@@ -1398,6 +1532,8 @@ int cls_camera::capture()
 /* call detection */
 void cls_camera::detection()
 {
+    int64_t prof_ts;
+
     if ((restart == true) || (handler_stop == true)) {
         return;
     }
@@ -1409,7 +1545,9 @@ void cls_camera::detection()
     }
 
     if (pause == false) {
+        prof_ts = profile->now();
         alg->diff();
+        profile->record(PROF_DIFF, prof_ts);
     } else {
         current_image->diffs = 0;
         current_image->diffs_raw = 0;
@@ -1685,6 +1823,8 @@ void cls_camera::actions_event()
 
 void cls_camera::actions()
 {
+    int64_t prof_ts;
+
     if ((restart == true) || (handler_stop == true)) {
         return;
     }
@@ -1712,6 +1852,9 @@ void cls_camera::actions()
         */
     }
 
+    movie_norm->preroll_put(current_image);
+    movie_norm->segment_put(current_image);
+
     if ((cfg->emulate_motion || event_user) && (startup_frames == 0)) {
         actions_emulate();
     } else if ((current_image->motion) && (startup_frames == 0)) {
@@ -1737,7 +1880,9 @@ void cls_camera::actions()
 
     areadetect();
 
+    prof_ts = profile->now();
     ring_process();
+    profile->record(PROF_RING, prof_ts);
 
     actions_event();
 
@@ -1889,50 +2034,121 @@ void cls_camera::check_schedule()
     */
 }
 
-/* sleep the loop to get framerate requested */
+/* Record how late the frame is against its deadline and the achieved rate */
+void cls_camera::frametiming_stats(struct timespec *ts)
+{
+    int64_t late, elapsed;
+    int indx;
+
+    late = ((ts->tv_sec - frame_timing.next_ts.tv_sec) * 1000000L) +
+        ((ts->tv_nsec - frame_timing.next_ts.tv_nsec) / 1000);
+    /* Wakeups from the absolute sleep are always slightly late */
+    if (late < 1000) {
+        indx = 0;
+    } else if (late < 5000) {
+        indx = 1;
+    } else if (late < 10000) {
+        indx = 2;
+    } else if (late < 50000) {
+        indx = 3;
+    } else {
+        indx = 4;
+    }
+    frame_timing.late[indx]++;
+    frame_timing.late_max = MAX(frame_timing.late_max, late);
+    frame_timing.frames++;
+    frame_timing.fps_cnt++;
+
+    elapsed = ((ts->tv_sec - frame_timing.fps_ts.tv_sec) * 1000000L) +
+        ((ts->tv_nsec - frame_timing.fps_ts.tv_nsec) / 1000);
+    if (elapsed >= 1000000L) {
+        frame_timing.fps = (double)(frame_timing.fps_cnt * 1000000L) / (double)elapsed;
+        frame_timing.fps_cnt = 0;
+        frame_timing.fps_ts = *ts;
+    }
+}
+
+/*
+ * Sleep the loop to get framerate requested.  Each frame has an absolute
+ * deadline one interval after the previous deadline so the time spent
+ * processing the frame and any oversleep do not accumulate as drift.
+ */
 void cls_camera::frametiming()
 {
     struct timespec ts2;
-    int64_t sleeptm;
+    int64_t interval, behind, missed;
 
     if ((restart == true) || (handler_stop == true)) {
         return;
     }
 
-    clock_gettime(CLOCK_MONOTONIC, &ts2);
-
-    sleeptm = ((1000000L / cfg->framerate) -
-          (1000000L * (ts2.tv_sec - frame_curr_ts.tv_sec)) -
-          ((ts2.tv_nsec - frame_curr_ts.tv_nsec)/1000))*1000;
+    interval = 1000000000L / cfg->framerate;
+    frame_timing.next_ts.tv_nsec += interval;
+    while (frame_timing.next_ts.tv_nsec >= 1000000000L) {
+        frame_timing.next_ts.tv_sec++;
+        frame_timing.next_ts.tv_nsec -= 1000000000L;
+    }
 
-    /* If over 1 second, just do one*/
-    if (sleeptm > 999999999L) {
-        SLEEP(1, 0);
-    } else if (sleeptm > 0) {
-        SLEEP(0, sleeptm);
+    clock_gettime(CLOCK_MONOTONIC, &ts2);
+    behind = ((ts2.tv_sec - frame_timing.next_ts.tv_sec) * 1000000000L) +
+        (ts2.tv_nsec - frame_timing.next_ts.tv_nsec);
+
+    if (behind > 0) {
+        /* Missed the deadline.  Burst catches up unless over a second behind */
+        missed = behind / interval;
+        if ((missed > 0) &&
+            ((cfg->framerate_policy == "drop") || (behind > 1000000000L))) {
+            frame_timing.skipped += missed;
+            frame_timing.next_ts.tv_sec += (time_t)((missed * interval) / 1000000000L);
+            frame_timing.next_ts.tv_nsec += (long)((missed * interval) % 1000000000L);
+            while (frame_timing.next_ts.tv_nsec >= 1000000000L) {
+                frame_timing.next_ts.tv_sec++;
+                frame_timing.next_ts.tv_nsec -= 1000000000L;
+            }
+        }
+    } else {
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME
+            , &frame_timing.next_ts, nullptr) == EINTR) {
+        }
+        clock_gettime(CLOCK_MONOTONIC, &ts2);
     }
 
+    frametiming_stats(&ts2);
+
     passflag = true;
 }
 
 void cls_camera::handler()
 {
+    int64_t prof_ts;
+
     mythreadname_set("cl", cfg->device_id, cfg->device_name.c_str());
     device_status = STATUS_INIT;
 
     while (handler_stop == false) {
         init();
         prepare();
+        prof_ts = profile->now();
         resetimages();
+        profile->begin();
         capture();
+        profile->mark(PROF_CAPTURE);
         detection();
+        profile->mark(PROF_DETECT);
         tuning();
+        profile->mark(PROF_TUNING);
         overlay();
+        profile->mark(PROF_OVERLAY);
         actions();
+        profile->mark(PROF_ACTIONS);
         snapshot();
+        profile->mark(PROF_SNAPSHOT);
         timelapse();
+        profile->mark(PROF_TIMELAPSE);
         loopback();
+        profile->mark(PROF_LOOPBACK);
         check_schedule();
+        profile->record(PROF_FRAME, prof_ts);
         frametiming();
     }
 
@@ -2046,6 +2262,8 @@ cls_camera::cls_camera(cls_motapp *p_app)
     missing_frame_counter = -1;
     schedule.clear();
     cleandir = nullptr;
+    storage = new cls_storage(this);
+    profile = new cls_profile();
 
     info_diff_tot = 0;
     info_diff_cnt = 0;
@@ -2079,6 +2297,8 @@ cls_camera::~cls_camera()
 {
     mydelete(conf_src);
     mydelete(cfg);
+    mydelete(storage);
+    mydelete(profile);
     pthread_mutex_destroy(&stream.mutex);
     device_status = STATUS_CLOSED;
 }
@@ -73,6 +73,20 @@ struct ctx_image_data {
     int                 total_labels;
 };
 
+/* Run of masked bytes in a plane */
+struct ctx_mask_span {
+    int     offset;
+    int     length;
+};
+
+/* Mask as runs.  NULL spans when the mask has too many runs */
+struct ctx_mask_spans {
+    ctx_mask_span   *y;         /* Masked runs in the Y plane */
+    int             y_cnt;
+    ctx_mask_span   *uv;        /* Masked runs in both the U and V planes */
+    int             uv_cnt;
+};
+
 struct ctx_images {
     ctx_image_data *image_ring;    /* The base address of the image ring buffer */
     ctx_image_data image_motion;   /* Picture buffer for motion images */
@@ -84,11 +98,14 @@ struct ctx_images {
     u_char *common_buffer;
     u_char *image_substream;
     u_char *image_virgin;            /* Last picture frame with no text or locate overlay */
+    u_char *image_virgin_buf;        /* Own copy for image_virgin when it differs from image_vprvcy */
     u_char *image_vprvcy;            /* Virgin image with the privacy mask applied */
     u_char *mask_privacy;            /* Buffer for the privacy mask values */
     u_char *mask_privacy_uv;         /* Buffer for the privacy U&V values */
     u_char *mask_privacy_high;       /* Buffer for the privacy mask values */
     u_char *mask_privacy_high_uv;    /* Buffer for the privacy U&V values */
+    ctx_mask_spans privacy_spans;       /* Masked runs of mask_privacy */
+    ctx_mask_spans privacy_spans_high;  /* Masked runs of mask_privacy_high */
     u_char *image_secondary;         /* Buffer for JPG from alg_sec methods */
 
     int ring_size;
@@ -134,6 +151,26 @@ struct ctx_cleandir {
     bool removedir;
     std::string dur_unit;
     int dur_val;
+    int max_size;       /* Megabytes of recordings to retain for camera. 0=no limit */
+    int max_pct;        /* Percent of target_dir filesystem permitted in use. 0=no limit */
+    int threads;        /* Number of workers removing files */
+    int rate;           /* Maximum files removed per second. 0=no limit */
+    int batch;          /* Number of files per database transaction */
+    time_t pct_retry;   /* Next max_pct pass between runs after one freed nothing */
+    time_t warn_ts;     /* Last budget warning.  0=budget met */
+};
+
+#define FRAME_LATE_BINS 5   /* On time (under 1ms late), under 5,10,50ms late and 50ms or more */
+
+struct ctx_frametiming {
+    struct timespec next_ts;    /* Absolute deadline of the next frame */
+    struct timespec fps_ts;     /* Start of the fps measurement window */
+    int64_t     fps_cnt;        /* Frames in the current window */
+    double      fps;            /* Achieved frames per second */
+    int64_t     frames;
+    int64_t     skipped;        /* Deadlines dropped to catch up */
+    int64_t     late_max;       /* Worst lateness in microseconds */
+    int64_t     late[FRAME_LATE_BINS];
 };
 
 class cls_camera {
@@ -146,6 +183,7 @@ class cls_camera {
         cls_config      *conf_src;
         ctx_images      imgs;
         ctx_stream      stream;
+        std::vector<ctx_coord> stream_roi;  /* Boxes of the stream images.  Uses stream.mutex */
         ctx_image_data  *current_image;
         cls_alg         *alg;
         cls_algsec      *algsec;
@@ -190,6 +228,7 @@ class cls_camera {
         bool    pause;
         std::string user_pause;
         int     missing_frame_counter;
+        ctx_frametiming frame_timing;
 
         uint64_t    info_diff_tot;
         uint64_t    info_diff_cnt;
@@ -198,11 +237,19 @@ class cls_camera {
         uint64_t    info_sdev_tot;
         std::vector<std::vector<ctx_schedule_data>> schedule;
         ctx_cleandir    *cleandir;
+        cls_storage     *storage;
+        cls_profile     *profile;
+        cls_movie       *movie_norm;
+        cls_movie       *movie_motion;
+        cls_movie       *movie_timelapse;
+        cls_movie       *movie_extpipe;
 
         bool    action_snapshot;    /* Make a snapshot */
         bool    event_stop;  /* Boolean for whether to stop a event */
         bool    event_user;  /* Boolean for whether to user triggered an event */
 
+        void roi_get(ctx_image_data *img_data, std::vector<ctx_coord> &dst);
+
         enum DEVICE_STATUS      device_status;
         enum CAMERA_TYPE        camera_type;
         struct timespec         connectionlosttime;
@@ -230,10 +277,6 @@ class cls_camera {
         void clear_libcam_ignored_controls();
 
     private:
-        cls_movie       *movie_norm;
-        cls_movie       *movie_motion;
-        cls_movie       *movie_timelapse;
-        cls_movie       *movie_extpipe;
         cls_v4l2cam     *v4l2cam;
         cls_libcam      *libcam;
 
@@ -266,6 +309,9 @@ class cls_camera {
         void track_move();
         void detected();
         void mask_privacy();
+        bool virgin_wanted();
+        void image_variants();
+        void mask_privacy_spans(u_char *image, ctx_mask_spans *spans, int size_y);
         void cam_close();
         void cam_start();
         int cam_next(ctx_image_data *img_data);
@@ -298,6 +344,7 @@ class cls_camera {
         void timelapse();
         void loopback();
         void check_schedule();
+        void frametiming_stats(struct timespec *ts);
         void frametiming();
 };
 
@@ -51,6 +51,7 @@ ctx_parm config_parms[] = {
     {"log_fflevel",               PARM_TYP_LIST,   PARM_CAT_00, PARM_LEVEL_LIMITED,  false},
     {"log_type",                  PARM_TYP_LIST,   PARM_CAT_00, PARM_LEVEL_LIMITED,  false},
     {"native_language",           PARM_TYP_BOOL,   PARM_CAT_00, PARM_LEVEL_LIMITED,  false},
+    {"encoder_file",              PARM_TYP_STRING, PARM_CAT_00, PARM_LEVEL_ADVANCED, false},
 
     /* Category 01 - Camera parameters - mostly NOT hot reloadable */
     {"device_name",               PARM_TYP_STRING, PARM_CAT_01, PARM_LEVEL_LIMITED,  true},   /* Display only */
@@ -59,6 +60,7 @@ ctx_parm config_parms[] = {
     {"pause",                     PARM_TYP_LIST,   PARM_CAT_01, PARM_LEVEL_LIMITED,  true},   /* Runtime control */
     {"schedule_params",           PARM_TYP_PARAMS, PARM_CAT_01, PARM_LEVEL_LIMITED,  false},
     {"cleandir_params",           PARM_TYP_PARAMS, PARM_CAT_01, PARM_LEVEL_LIMITED,  false},
+    {"storage_params",            PARM_TYP_PARAMS, PARM_CAT_01, PARM_LEVEL_LIMITED,  false},
     {"target_dir",                PARM_TYP_STRING, PARM_CAT_01, PARM_LEVEL_ADVANCED, false},
     {"watchdog_tmo",              PARM_TYP_INT,    PARM_CAT_01, PARM_LEVEL_LIMITED,  false},
     {"watchdog_kill",             PARM_TYP_INT,    PARM_CAT_01, PARM_LEVEL_LIMITED,  false},
@@ -76,6 +78,8 @@ ctx_parm config_parms[] = {
     {"libcam_device",             PARM_TYP_STRING, PARM_CAT_02, PARM_LEVEL_ADVANCED, false},
     {"libcam_params",             PARM_TYP_PARAMS, PARM_CAT_02, PARM_LEVEL_ADVANCED, false},
     {"libcam_buffer_count",       PARM_TYP_INT,    PARM_CAT_02, PARM_LEVEL_ADVANCED, false},
+    {"libcam_lores_width",        PARM_TYP_INT,    PARM_CAT_02, PARM_LEVEL_ADVANCED, false},
+    {"libcam_lores_height",       PARM_TYP_INT,    PARM_CAT_02, PARM_LEVEL_ADVANCED, false},
     {"libcam_brightness",         PARM_TYP_STRING, PARM_CAT_02, PARM_LEVEL_ADVANCED, true},
     {"libcam_contrast",           PARM_TYP_STRING, PARM_CAT_02, PARM_LEVEL_ADVANCED, true},
     {"libcam_iso",                PARM_TYP_INT,    PARM_CAT_02, PARM_LEVEL_ADVANCED, true},
@@ -95,6 +99,7 @@ ctx_parm config_parms[] = {
     {"width",                     PARM_TYP_INT,    PARM_CAT_03, PARM_LEVEL_LIMITED,  false},
     {"height",                    PARM_TYP_INT,    PARM_CAT_03, PARM_LEVEL_LIMITED,  false},
     {"framerate",                 PARM_TYP_INT,    PARM_CAT_03, PARM_LEVEL_LIMITED,  false},
+    {"framerate_policy",          PARM_TYP_LIST,   PARM_CAT_03, PARM_LEVEL_LIMITED,  true},
     {"rotate",                    PARM_TYP_LIST,   PARM_CAT_03, PARM_LEVEL_LIMITED,  false},
     {"flip_axis",                 PARM_TYP_LIST,   PARM_CAT_03, PARM_LEVEL_LIMITED,  false},
 
@@ -168,6 +173,7 @@ ctx_parm config_parms[] = {
     {"movie_max_time",            PARM_TYP_INT,    PARM_CAT_10, PARM_LEVEL_LIMITED,  true},
     {"movie_bps",                 PARM_TYP_INT,    PARM_CAT_10, PARM_LEVEL_LIMITED,  false},  /* Encoder config */
     {"movie_quality",             PARM_TYP_INT,    PARM_CAT_10, PARM_LEVEL_LIMITED,  false},  /* Encoder config */
+    {"movie_roi",                 PARM_TYP_INT,    PARM_CAT_10, PARM_LEVEL_LIMITED,  false},  /* Encoder config */
     {"movie_encoder_preset",      PARM_TYP_LIST,   PARM_CAT_10, PARM_LEVEL_LIMITED,  false},  /* Encoder config */
     {"movie_container",           PARM_TYP_STRING, PARM_CAT_10, PARM_LEVEL_LIMITED,  false},  /* Encoder config */
     {"movie_passthrough",         PARM_TYP_BOOL,   PARM_CAT_10, PARM_LEVEL_LIMITED,  false},  /* Encoder config */
@@ -176,6 +182,7 @@ ctx_parm config_parms[] = {
     {"movie_all_frames",          PARM_TYP_BOOL,   PARM_CAT_10, PARM_LEVEL_LIMITED,  false},  /* Encoder config */
     {"movie_extpipe_use",         PARM_TYP_BOOL,   PARM_CAT_10, PARM_LEVEL_RESTRICTED, false},
     {"movie_extpipe",             PARM_TYP_STRING, PARM_CAT_10, PARM_LEVEL_RESTRICTED, false},
+    {"movie_params",              PARM_TYP_PARAMS, PARM_CAT_10, PARM_LEVEL_LIMITED,  false},
 
     /* Category 11 - Timelapse parameters - NOT hot reloadable */
     {"timelapse_interval",        PARM_TYP_INT,    PARM_CAT_11, PARM_LEVEL_LIMITED,  false},
@@ -653,6 +660,8 @@ void cls_config::dispatch_edit(const std::string& name, std::string& parm, enum
     if (name == "watchdog_tmo") return edit_generic_int(watchdog_tmo, parm, pact, 90, 1, INT_MAX);
     if (name == "watchdog_kill") return edit_generic_int(watchdog_kill, parm, pact, 0, 0, INT_MAX);
     if (name == "libcam_buffer_count") return edit_generic_int(libcam_buffer_count, parm, pact, 4, 2, 8);
+    if (name == "libcam_lores_width") return edit_generic_int(libcam_lores_width, parm, pact, 0, 0, 9999);
+    if (name == "libcam_lores_height") return edit_generic_int(libcam_lores_height, parm, pact, 0, 0, 9999);
     if (name == "width") return edit_generic_int(width, parm, pact, 640, 64, 9999);
     if (name == "height") return edit_generic_int(height, parm, pact, 480, 64, 9999);
     if (name == "framerate") return edit_generic_int(framerate, parm, pact, 15, 2, 100);
@@ -679,6 +688,7 @@ void cls_config::dispatch_edit(const std::string& name, std::string& parm, enum
     if (name == "movie_max_time") return edit_generic_int(movie_max_time, parm, pact, 120, 0, 2147483647);
     if (name == "movie_bps") return edit_generic_int(movie_bps, parm, pact, 400000, 0, INT_MAX);
     if (name == "movie_quality") return edit_generic_int(movie_quality, parm, pact, 60, 1, 100);
+    if (name == "movie_roi") return edit_generic_int(movie_roi, parm, pact, 0, 0, 100);
     if (name == "timelapse_interval") return edit_generic_int(timelapse_interval, parm, pact, 0, 0, 2147483647);
     if (name == "timelapse_fps") return edit_generic_int(timelapse_fps, parm, pact, 30, 1, 100);
     if (name == "webcontrol_port") return edit_generic_int(webcontrol_port, parm, pact, 8080, 0, 65535);
@@ -722,6 +732,7 @@ void cls_config::dispatch_edit(const std::string& name, std::string& parm, enum
     // STRINGS (simple assignment)
     if (name == "conf_filename") return edit_generic_string(conf_filename, parm, pact, "");
     if (name == "pid_file") return edit_generic_string(pid_file, parm, pact, "");
+    if (name == "encoder_file") return edit_generic_string(encoder_file, parm, pact, "");
     if (name == "device_name") return edit_generic_string(device_name, parm, pact, "");
     if (name == "v4l2_device") return edit_generic_string(v4l2_device, parm, pact, "");
     if (name == "v4l2_params") return edit_generic_string(v4l2_params, parm, pact, "");
@@ -740,6 +751,7 @@ void cls_config::dispatch_edit(const std::string& name, std::string& parm, enum
     if (name == "libcam_params") return edit_generic_string(libcam_params, parm, pact, "");
     if (name == "schedule_params") return edit_generic_string(schedule_params, parm, pact, "");
     if (name == "cleandir_params") return edit_generic_string(cleandir_params, parm, pact, "");
+    if (name == "storage_params") return edit_generic_string(storage_params, parm, pact, "");
     if (name == "config_dir") return edit_generic_string(config_dir, parm, pact, "");
     if (name == "text_left") return edit_generic_string(text_left, parm, pact, "");
     if (name == "text_right") return edit_generic_string(text_right, parm, pact, "%Y-%m-%d\\n%T");
@@ -763,6 +775,7 @@ void cls_config::dispatch_edit(const std::string& name, std::string& parm, enum
     if (name == "on_sound_alert") return edit_generic_string(on_sound_alert, parm, pact, "");
     if (name == "picture_exif") return edit_generic_string(picture_exif, parm, pact, "");
     if (name == "movie_extpipe") return edit_generic_string(movie_extpipe, parm, pact, "");
+    if (name == "movie_params") return edit_generic_string(movie_params, parm, pact, "");
     if (name == "video_pipe") return edit_generic_string(video_pipe, parm, pact, "");
     if (name == "video_pipe_motion") return edit_generic_string(video_pipe_motion, parm, pact, "");
     if (name == "webcontrol_base_path") return edit_generic_string(webcontrol_base_path, parm, pact, "/");
@@ -806,6 +819,9 @@ void cls_config::dispatch_edit(const std::string& name, std::string& parm, enum
     static const std::vector<std::string> flip_axis_values = {"none","vertical","horizontal"};
     if (name == "flip_axis") return edit_generic_list(flip_axis, parm, pact, "none", flip_axis_values);
 
+    static const std::vector<std::string> framerate_policy_values = {"drop","burst"};
+    if (name == "framerate_policy") return edit_generic_list(framerate_policy, parm, pact, "drop", framerate_policy_values);
+
     static const std::vector<std::string> locate_motion_mode_values = {"off","on","preview"};
     if (name == "locate_motion_mode") return edit_generic_list(locate_motion_mode, parm, pact, "off", locate_motion_mode_values);
 
@@ -827,7 +843,7 @@ void cls_config::dispatch_edit(const std::string& name, std::string& parm, enum
     static const std::vector<std::string> movie_encoder_preset_values = {"ultrafast","superfast","veryfast","faster","fast","medium","slow","slower","veryslow"};
     if (name == "movie_encoder_preset") return edit_generic_list(movie_encoder_preset, parm, pact, "medium", movie_encoder_preset_values);
 
-    static const std::vector<std::string> movie_container_values = {"mkv","mp4","3gp"};
+    static const std::vector<std::string> movie_container_values = {"mkv","mp4","3gp","fmp4"};
     if (name == "movie_container") return edit_generic_list(movie_container, parm, pact, "mkv", movie_container_values);
 
     if (name == "movie_passthrough") return edit_generic_bool(movie_passthrough, parm, pact, false);
@@ -1132,6 +1148,7 @@ void cls_config::usage(void)
     printf("-p process_id_file\tFull path and filename of process id file (pid file).\n");
     printf("-l log file \t\tFull path and filename of log file.\n");
     printf("-m\t\t\tDisable detection at startup.\n");
+    printf("--bench-encoders\tTime the encoders, record the fastest suitable and exit.\n");
     printf("-h\t\t\tShow this screen.\n");
     printf("\n");
 }
@@ -1140,7 +1157,13 @@ void cls_config::cmdline()
 {
     int c;
 
-    while ((c = getopt(app->argc, app->argv, "bc:d:hmn?p:k:l:")) != EOF)
+    static struct option long_opts[] = {
+        {"bench-encoders", no_argument, nullptr, 'B'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    while ((c = getopt_long(app->argc, app->argv, "bc:d:hmn?p:k:l:"
+        , long_opts, nullptr)) != EOF)
         switch (c) {
         case 'c':
             edit_set("conf_filename", optarg);
@@ -1166,6 +1189,9 @@ void cls_config::cmdline()
         case 'm':
             app->user_pause = "on";
             break;
+        case 'B':
+            app->bench_encoders = true;
+            break;
         case 'h':
         case '?':
         default:
@@ -121,6 +121,7 @@
             int&            log_fflevel             = parm_app.log_fflevel;
             int&            log_type                = parm_app.log_type;
             bool&           native_language         = parm_app.native_language;
+            std::string&    encoder_file            = parm_app.encoder_file;
 
             /* Camera device parameters (-> parm_cam) */
             std::string&    device_name             = parm_cam.device_name;
@@ -133,6 +134,7 @@
             std::string&    pause                   = parm_cam.pause;
             std::string&    schedule_params         = parm_cam.schedule_params;
             std::string&    cleandir_params         = parm_cam.cleandir_params;
+            std::string&    storage_params          = parm_cam.storage_params;
 
             /* Source parameters (-> parm_cam) */
             std::string&    v4l2_device             = parm_cam.v4l2_device;
@@ -145,11 +147,14 @@
             std::string&    libcam_device           = parm_cam.libcam_device;
             std::string&    libcam_params           = parm_cam.libcam_params;
             int&            libcam_buffer_count     = parm_cam.libcam_buffer_count;
+            int&            libcam_lores_width      = parm_cam.libcam_lores_width;
+            int&            libcam_lores_height     = parm_cam.libcam_lores_height;
 
             /* Image parameters (-> parm_cam) */
             int&            width                   = parm_cam.width;
             int&            height                  = parm_cam.height;
             int&            framerate               = parm_cam.framerate;
+            std::string&    framerate_policy        = parm_cam.framerate_policy;
             int&            rotate                  = parm_cam.rotate;
             std::string&    flip_axis               = parm_cam.flip_axis;
 
@@ -225,6 +230,7 @@
             int&            movie_max_time          = parm_cam.movie_max_time;
             int&            movie_bps               = parm_cam.movie_bps;
             int&            movie_quality           = parm_cam.movie_quality;
+            int&            movie_roi               = parm_cam.movie_roi;
             std::string&    movie_encoder_preset    = parm_cam.movie_encoder_preset;
             std::string&    movie_container         = parm_cam.movie_container;
             bool&           movie_passthrough       = parm_cam.movie_passthrough;
@@ -233,6 +239,7 @@
             bool&           movie_all_frames        = parm_cam.movie_all_frames;
             bool&           movie_extpipe_use       = parm_cam.movie_extpipe_use;
             std::string&    movie_extpipe           = parm_cam.movie_extpipe;
+            std::string&    movie_params            = parm_cam.movie_params;
 
             /* Timelapse parameters (-> parm_cam) */
             int&            timelapse_interval      = parm_cam.timelapse_interval;
@@ -253,7 +253,13 @@ void cls_config_file::cmdline()
 {
     int c;
 
-    while ((c = getopt(app->argc, app->argv, "bc:d:hmn?p:k:l:")) != EOF)
+    static struct option long_opts[] = {
+        {"bench-encoders", no_argument, nullptr, 'B'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    while ((c = getopt_long(app->argc, app->argv, "bc:d:hmn?p:k:l:"
+        , long_opts, nullptr)) != EOF)
         switch (c) {
         case 'c':
             config->edit_set("conf_filename", optarg);
@@ -279,6 +285,9 @@ void cls_config_file::cmdline()
         case 'm':
             app->user_pause = "on";
             break;
+        case 'B':
+            app->bench_encoders = true;
+            break;
         case 'h':
         case '?':
         default:
@@ -21,6 +21,7 @@
 #include "camera.hpp"
 #include "conf.hpp"
 #include "logger.hpp"
+#include "evwait.hpp"
 #include "dbse.hpp"
 
 /**
@@ -87,6 +88,8 @@ void cls_dbse::cols_vec_create()
     cols_vec_add("sdev_min","int");
     cols_vec_add("sdev_max","int");
     cols_vec_add("sdev_avg","int");
+    cols_vec_add("evt_off","int");
+    cols_vec_add("evt_len","int");
 }
 
 void cls_dbse::item_default()
@@ -106,6 +109,8 @@ void cls_dbse::item_default()
     file_item.sdev_min  = 0;
     file_item.sdev_max  = 0;
     file_item.sdev_avg  = 0;
+    file_item.evt_off  = 0;
+    file_item.evt_len  = 0;
 
 }
 
@@ -145,6 +150,10 @@ void cls_dbse::item_assign(std::string col_nm, std::string col_val)
         file_item.sdev_max = mtoi(col_val);
     } else if (col_nm == "sdev_avg") {
         file_item.sdev_avg = mtoi(col_val);
+    } else if (col_nm == "evt_off") {
+        file_item.evt_off = mtoi(col_val);
+    } else if (col_nm == "evt_len") {
+        file_item.evt_len = mtoi(col_val);
     }
 }
 
@@ -1063,6 +1072,29 @@ void cls_dbse::shutdown()
     #endif
 }
 
+/* Caller must hold mutex_dbse */
+void cls_dbse::exec_nolock(std::string sql)
+{
+    #ifdef HAVE_MARIADB
+        if (app->cfg->database_type == "mariadb") {
+            mariadb_exec(sql);
+        }
+    #endif
+    #ifdef HAVE_PGSQLDB
+        if (app->cfg->database_type == "postgresql") {
+            pgsqldb_exec(sql);
+        }
+    #endif
+    #ifdef HAVE_SQLITE3DB
+        if (app->cfg->database_type == "sqlite3") {
+            sqlite3db_exec(sql);
+        }
+    #endif
+    #ifndef HAVE_DBSE
+        (void)sql;
+    #endif
+}
+
 void cls_dbse::exec_sql(std::string sql)
 {
     if (dbse_open() == false) {
@@ -1070,26 +1102,89 @@ void cls_dbse::exec_sql(std::string sql)
     }
 
     pthread_mutex_lock(&mutex_dbse);
-        #ifdef HAVE_MARIADB
-            if (app->cfg->database_type == "mariadb") {
-                mariadb_exec(sql);
+        exec_nolock(sql);
+    pthread_mutex_unlock(&mutex_dbse);
+
+}
+
+/*
+ * Remove a list of records using a single transaction.  The ids are
+ * grouped into "in" lists so that a large purge is a handful of
+ * statements rather than one statement per file.  The event rows
+ * within the removed files in p_fullnms are deleted in the same
+ * transaction.
+ */
+void cls_dbse::filelist_del(std::vector<int64_t> &p_recids
+    , std::vector<std::string> &p_fullnms)
+{
+    std::string sql, delimit;
+    size_t indx;
+    int delcnt;
+
+    if ((p_recids.size() == 0) || (dbse_open() == false)) {
+        return;
+    }
+    if (finish == true) {
+        return;
+    }
+
+    pthread_mutex_lock(&mutex_dbse);
+        /* mariadb_exec commits each statement so no explicit transaction*/
+        if (app->cfg->database_type != "mariadb") {
+            exec_nolock("begin;");
+        }
+        delcnt = 0;
+        sql = "";
+        for (indx=0; indx<p_recids.size(); indx++) {
+            if (sql == "") {
+                sql  = " delete from motion ";
+                sql += " where record_id in (";
+                delimit = " ";
+                delcnt = 0;
             }
-        #endif
-        #ifdef HAVE_PGSQLDB
-            if (app->cfg->database_type == "postgresql") {
-                pgsqldb_exec(sql);
+            sql += delimit + std::to_string(p_recids[indx]);
+            delimit = ",";
+            delcnt++;
+            if (delcnt == 500) {
+                sql += ");";
+                exec_nolock(sql);
+                sql = "";
+                delcnt = 0;
             }
-        #endif
-        #ifdef HAVE_SQLITE3DB
-            if (app->cfg->database_type == "sqlite3") {
-                sqlite3db_exec(sql);
+        }
+        if (delcnt != 0) {
+            sql += ");";
+            exec_nolock(sql);
+        }
+        sql = "";
+        for (indx=0; indx<p_fullnms.size(); indx++) {
+            if (sql == "") {
+                sql  = " delete from motion ";
+                sql += " where file_typ = 'event' and full_nm in (";
+                delimit = " ";
+                delcnt = 0;
             }
-        #endif
-        #ifndef HAVE_DBSE
-            (void)sql;
-        #endif
+            sql += delimit + "'" + dbse_escape_sql_string(p_fullnms[indx]) + "'";
+            delimit = ",";
+            delcnt++;
+            if (delcnt == 500) {
+                sql += ");";
+                exec_nolock(sql);
+                sql = "";
+                delcnt = 0;
+            }
+        }
+        if (delcnt != 0) {
+            sql += ");";
+            exec_nolock(sql);
+        }
+        if (app->cfg->database_type != "mariadb") {
+            exec_nolock("commit;");
+        }
     pthread_mutex_unlock(&mutex_dbse);
 
+    MOTION_LOG(DBG, TYPE_DB, NO_ERRNO
+        , "Removed %d records", (int)p_recids.size());
 }
 
 void cls_dbse::exec(cls_camera *cam, std::string fname, std::string cmd)
@@ -1126,6 +1221,21 @@ void cls_dbse::exec(cls_camera *cam, std::string fname, std::string cmd)
 
 void cls_dbse::filelist_add(cls_camera *cam, timespec *ts1, std::string ftyp
     ,std::string filenm, std::string fullnm, std::string dirnm)
+{
+    filelist_insert(cam, ts1, ftyp, filenm, fullnm, dirnm, 0, 0);
+}
+
+/* Add an event as a time range within a continuous recording */
+void cls_dbse::eventlist_add(cls_camera *cam, timespec *ts1
+    ,std::string filenm, std::string fullnm, std::string dirnm
+    ,int evt_off, int evt_len)
+{
+    filelist_insert(cam, ts1, "event", filenm, fullnm, dirnm, evt_off, evt_len);
+}
+
+void cls_dbse::filelist_insert(cls_camera *cam, timespec *ts1, std::string ftyp
+    ,std::string filenm, std::string fullnm, std::string dirnm
+    ,int evt_off, int evt_len)
 {
     std::string sqlquery;
     struct stat statbuf;
@@ -1143,7 +1253,10 @@ void cls_dbse::filelist_add(cls_camera *cam, timespec *ts1, std::string ftyp
 
     cam->watchdog = cam->cfg->watchdog_tmo;
 
-    if (stat(fullnm.c_str(), &statbuf) == 0) {
+    /* Event rows point into a segment whose bytes its own row counts */
+    if (ftyp == "event") {
+        bsz = 0;
+    } else if (stat(fullnm.c_str(), &statbuf) == 0) {
         bsz = statbuf.st_size;
     } else {
         bsz = 0;
@@ -1168,7 +1281,8 @@ void cls_dbse::filelist_add(cls_camera *cam, timespec *ts1, std::string ftyp
     sqlquery += " (device_id, file_nm, file_typ, file_dir";
     sqlquery += " , full_nm, file_sz, file_dtl";
     sqlquery += " , file_tmc, file_tml, diff_avg";
-    sqlquery += " , sdev_min, sdev_max, sdev_avg)";
+    sqlquery += " , sdev_min, sdev_max, sdev_avg";
+    sqlquery += " , evt_off, evt_len)";
     sqlquery += " values ("+std::to_string(cam->cfg->device_id);
     /* Use SQL escaping to prevent injection attacks */
     sqlquery += " ,'" + dbse_escape_sql_string(filenm) + "'";
@@ -1183,6 +1297,8 @@ void cls_dbse::filelist_add(cls_camera *cam, timespec *ts1, std::string ftyp
     sqlquery += " ,"  + std::to_string(cam->info_sdev_min);
     sqlquery += " ,"  + std::to_string(cam->info_sdev_max);
     sqlquery += " ,"  + std::to_string(sdev_avg);
+    sqlquery += " ,"  + std::to_string(evt_off);
+    sqlquery += " ,"  + std::to_string(evt_len);
     sqlquery += ")";
 
     exec_sql(sqlquery);
@@ -1303,18 +1419,21 @@ bool cls_dbse::check_exit()
     return false;
 }
 
+void cls_dbse::wake()
+{
+    evwait->wake();
+}
+
+/* Wait until the top of the next hour or until woken for shutdown */
 void cls_dbse::timing()
 {
-    int waitcnt;
+    struct timespec ts2;
 
-    waitcnt = 0;
-    while (waitcnt < 30) {
-        if (check_exit() == true) {
-            return;
-        }
-        SLEEP(1,0);
-        waitcnt++;
+    if (check_exit() == true) {
+        return;
     }
+    clock_gettime(CLOCK_REALTIME, &ts2);
+    evwait->wait_for(3600 - (ts2.tv_sec % 3600), 0);
 }
 
 void cls_dbse::handler()
@@ -1325,9 +1444,9 @@ void cls_dbse::handler()
 
     mythreadname_set("dl", 0, "dbsl");
 
-    hr_prev = 0;
+    hr_prev = -1;
     while (check_exit() == false) {
-        clock_gettime(CLOCK_MONOTONIC, &ts2);
+        clock_gettime(CLOCK_REALTIME, &ts2);
         localtime_r(&ts2.tv_sec, &lcl_tm);
         hr_cur = lcl_tm.tm_hour;
         if (hr_cur != hr_prev) {
@@ -1370,6 +1489,7 @@ void cls_dbse::handler_shutdown()
 
     if (handler_running == true) {
         handler_stop = true;
+        evwait->wake();
         waitcnt = 0;
         while ((handler_running == true) && (waitcnt < app->cfg->watchdog_tmo)){
             SLEEP(1,0)
@@ -1413,6 +1533,7 @@ cls_dbse::cls_dbse(cls_motapp *p_app)
     finish = false;
     handler_running = false;
     handler_stop = true;
+    evwait = new cls_evwait();
 
     pthread_mutex_lock(&mutex_dbse);
         startup();
@@ -1427,4 +1548,5 @@ cls_dbse::~cls_dbse()
     handler_shutdown();
     shutdown();
     pthread_mutex_destroy(&mutex_dbse);
+    mydelete(evwait);
 }
@@ -68,6 +68,8 @@ struct ctx_file_item {
     int         sdev_min;   /*std dev min */
     int         sdev_max;   /*std dev max */
     int         sdev_avg;   /*std dev average */
+    int         evt_off;    /*Seconds into the file that the event starts */
+    int         evt_len;    /*Seconds of the event within the file */
 };
 typedef std::vector<ctx_file_item> vec_files;
 
@@ -90,7 +92,12 @@ class cls_dbse {
         void exec_sql(std::string sql);
         void filelist_add(cls_camera *cam, timespec *ts1, std::string ftyp
             ,std::string filenm, std::string fullnm, std::string dirnm);
+        void eventlist_add(cls_camera *cam, timespec *ts1
+            ,std::string filenm, std::string fullnm, std::string dirnm
+            ,int evt_off, int evt_len);
         void filelist_get(std::string sql, vec_files &p_flst);
+        void filelist_del(std::vector<int64_t> &p_recids
+            , std::vector<std::string> &p_fullnms);
         bool restart;
         bool finish;
         void shutdown();
@@ -100,6 +107,7 @@ class cls_dbse {
         bool            handler_running;
         pthread_t       handler_thread;
         void            handler();
+        void            wake();
 
     private:
         #ifdef HAVE_SQLITE3DB
@@ -134,6 +142,7 @@ class cls_dbse {
             void pgsqldb_filelist(std::string sql);
         #endif
         cls_motapp          *app;
+        cls_evwait          *evwait;
         enum DBSE_ACT       dbse_action;    /* action to perform with query*/
         bool                table_ok;       /* bool of whether table exists*/
         bool                is_open;
@@ -146,6 +155,10 @@ class cls_dbse {
         void handler_shutdown();
         void timing();
         bool check_exit();
+        void exec_nolock(std::string sql);
+        void filelist_insert(cls_camera *cam, timespec *ts1, std::string ftyp
+            ,std::string filenm, std::string fullnm, std::string dirnm
+            ,int evt_off, int evt_len);
         void dbse_clean();
         void dbse_edits();
         bool dbse_open();
@@ -1077,9 +1077,11 @@ int cls_draw::textn(u_char *image
         , const char *text, int len, int factor)
 {
 
-    int x, y;
-    int pos, line_offset, next_char_offs;
-    u_char *image_ptr, *char_ptr;
+    int y, fy, indx;
+    int pos, pos_check;
+    u_char *char_ptr, *row_ptr;
+    ctx_glyph *glyph;
+    ctx_glyph_run *run;
 
     if (startx > width / 2) {
         startx -= len * (6 * factor);
@@ -1093,42 +1095,28 @@ int cls_draw::textn(u_char *image
         return 0;
     }
 
-    line_offset = width - (7 * factor);
-    next_char_offs = (width * 8 * factor) - (6 * factor);
-
-    image_ptr = image + startx + (starty * width);
+    char_ptr = image + startx + (starty * width);
 
     for (pos = 0; pos < len; pos++) {
-        int pos_check = (int)text[pos];
-
-        char_ptr = char_arr_ptr[pos_check];
-
-        for (y = 0; y < 8 * factor; y++) {
-            for (x = 0; x < 7 * factor; x++) {
-
-                if (pos_check < 0) {
-                    image_ptr++;
-                    continue;
+        pos_check = (int)text[pos];
+        if ((pos_check < 0) || (pos_check >= ASCII_MAX)) {
+            char_ptr += 6 * factor;
+            continue;
+        }
+        glyph = &glyphs[pos_check];
+
+        /* Each run of the glyph row is one fill per image row */
+        for (y = 0; y < 8; y++) {
+            row_ptr = char_ptr + (y * factor * width);
+            for (indx = 0; indx < glyph->run_cnt[y]; indx++) {
+                run = &glyph->run[y][indx];
+                for (fy = 0; fy < factor; fy++) {
+                    memset(row_ptr + (fy * width) + (run->x * factor)
+                        , run->val, (uint)(run->len * factor));
                 }
-
-                char_ptr = char_arr_ptr[pos_check] + y/factor*7 + x/factor;
-
-                switch(*char_ptr) {
-                case 1:
-                    *image_ptr = 0;
-                     break;
-                case 2:
-                    *image_ptr = 255;
-                    break;
-                default:
-                    break;
-                }
-
-                image_ptr++;
             }
-            image_ptr += line_offset;
         }
-        image_ptr -= next_char_offs;
+        char_ptr += 6 * factor;
     }
 
     return 0;
@@ -1211,6 +1199,36 @@ void cls_draw::init_chars(void)
         char_arr_ptr[(int)draw_table[i].ascii] = &draw_table[i].pix[0][0];
     }
 
+    for (i = 0; i < ASCII_MAX; i++) {
+        init_glyph(&glyphs[i], char_arr_ptr[i]);
+    }
+
+}
+
+/* Convert the 8x7 pixels of a character into runs of outline and body */
+void cls_draw::init_glyph(ctx_glyph *glyph, const u_char *pix)
+{
+    int y, x, st;
+
+    for (y = 0; y < 8; y++) {
+        glyph->run_cnt[y] = 0;
+        x = 0;
+        while (x < 7) {
+            if (pix[(y * 7) + x] == 0) {
+                x++;
+                continue;
+            }
+            st = x;
+            while ((x < 7) && (pix[(y * 7) + x] == pix[(y * 7) + st])) {
+                x++;
+            }
+            glyph->run[y][glyph->run_cnt[y]].x = (u_char)st;
+            glyph->run[y][glyph->run_cnt[y]].len = (u_char)(x - st);
+            glyph->run[y][glyph->run_cnt[y]].val =
+                (pix[(y * 7) + st] == 1) ? 0 : 255;
+            glyph->run_cnt[y]++;
+        }
+    }
 }
 
 void cls_draw::init_scale()
@@ -1438,6 +1456,105 @@ void cls_draw::locate()
 
 }
 
+/* Count or record the runs of 0 in the plane.  Returns the count */
+static int draw_runs(const u_char *plane, int size, ctx_mask_span *spans)
+{
+    int indx, cnt, st;
+
+    cnt = 0;
+    indx = 0;
+    while (indx < size) {
+        if (plane[indx] != 0) {
+            indx++;
+            continue;
+        }
+        st = indx;
+        while ((indx < size) && (plane[indx] == 0)) {
+            indx++;
+        }
+        if (spans != NULL) {
+            spans[cnt].offset = st;
+            spans[cnt].length = indx - st;
+        }
+        cnt++;
+    }
+    return cnt;
+}
+
+void cls_draw::free_spans(ctx_mask_spans *spans)
+{
+    myfree(spans->y);
+    myfree(spans->uv);
+    spans->y_cnt = 0;
+    spans->uv_cnt = 0;
+}
+
+/*
+ * Convert a motion sized mask into the runs of masked pixels so the
+ * overlay only touches those bytes of the motion image.  A chroma sample
+ * is masked when any of its four pixels are.  A mask with many short
+ * runs is left to the full pass instead.
+ */
+void cls_draw::init_spans(ctx_mask_spans *spans, u_char *mask)
+{
+    int i, x, width, height, line;
+    u_char *mask_uv, *out_uv;
+
+    free_spans(spans);
+
+    width = cam->imgs.width;
+    height = cam->imgs.height;
+
+    spans->y_cnt = draw_runs(mask, cam->imgs.motionsize, NULL);
+    if ((spans->y_cnt * 64) > cam->imgs.motionsize) {
+        spans->y_cnt = 0;
+        return;
+    }
+
+    mask_uv =(u_char*) mymalloc((uint)cam->imgs.motionsize / 4);
+    out_uv = mask_uv;
+    for (i = 0; i < height; i += 2) {
+        line = i * width;
+        for (x = 0; x < width; x += 2) {
+            if (mask[line + x] == 0 || mask[line + x + 1] == 0 ||
+                mask[line + width + x] == 0 ||
+                mask[line + width + x + 1] == 0) {
+                *out_uv = 0;
+            } else {
+                *out_uv = 255;
+            }
+            out_uv++;
+        }
+    }
+    spans->uv_cnt = draw_runs(mask_uv, cam->imgs.motionsize / 4, NULL);
+
+    spans->y =(ctx_mask_span*) mymalloc(sizeof(ctx_mask_span) * (uint)MAX(spans->y_cnt, 1));
+    spans->uv =(ctx_mask_span*) mymalloc(sizeof(ctx_mask_span) * (uint)MAX(spans->uv_cnt, 1));
+    draw_runs(mask, cam->imgs.motionsize, spans->y);
+    draw_runs(mask_uv, cam->imgs.motionsize / 4, spans->uv);
+
+    myfree(mask_uv);
+}
+
+/* Set the masked runs of the motion image */
+void cls_draw::draw_spans(ctx_mask_spans *spans, u_char *out
+    , u_char val_u, u_char val_v)
+{
+    u_char *out_u, *out_v;
+    int indx;
+
+    for (indx = 0; indx < spans->y_cnt; indx++) {
+        memset(out + spans->y[indx].offset, 0, (uint)spans->y[indx].length);
+    }
+
+    out_u = out + cam->imgs.motionsize;
+    out_v = out_u + (cam->imgs.motionsize / 4);
+    for (indx = 0; indx < spans->uv_cnt; indx++) {
+        memset(out_u + spans->uv[indx].offset, val_u, (uint)spans->uv[indx].length);
+        memset(out_v + spans->uv[indx].offset, val_v, (uint)spans->uv[indx].length);
+    }
+}
+
 void cls_draw::smartmask()
 {
     int i, x, v, width, height, line;
@@ -1446,6 +1563,16 @@ void cls_draw::smartmask()
     u_char *out_y, *out_u, *out_v;
     u_char *out = cam->imgs.image_motion.image_norm;
 
+    /* The mask only changes when it is tuned so rebuild the runs then */
+    if (spans_smart_gen != cam->alg->smartmask_gen) {
+        init_spans(&spans_smart, mask_final);
+        spans_smart_gen = cam->alg->smartmask_gen;
+    }
+    if (spans_smart.y != NULL) {
+        draw_spans(&spans_smart, out, 128, 255);
+        return;
+    }
+
     i = imgs->motionsize;
     v = i + ((imgs->motionsize) / 4);
     width = imgs->width;
@@ -1486,6 +1613,15 @@ void cls_draw::fixed_mask()
     u_char *out_y, *out_u, *out_v;
     u_char *out = cam->imgs.image_motion.image_norm;
 
+    if (spans_fixed_init == false) {
+        init_spans(&spans_fixed, mask);
+        spans_fixed_init = true;
+    }
+    if (spans_fixed.y != NULL) {
+        draw_spans(&spans_fixed, out, 0, 0);
+        return;
+    }
+
     i = imgs->motionsize;
     v = i + ((imgs->motionsize) / 4);
     width = imgs->width;
@@ -1564,10 +1700,16 @@ cls_draw::cls_draw(cls_camera *p_cam)
     init_chars();
     init_scale();
 
+    memset(&spans_fixed, 0, sizeof(spans_fixed));
+    memset(&spans_smart, 0, sizeof(spans_smart));
+    spans_fixed_init = false;
+    spans_smart_gen = -1;
+
 }
 
 cls_draw::~cls_draw()
 {
-
+    free_spans(&spans_fixed);
+    free_spans(&spans_smart);
 }
 
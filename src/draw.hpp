@@ -21,6 +21,19 @@
     #define ASCII_MAX 127
     #define NEWLINE "\\n"
 
+    /* Horizontal run of one value in a row of a glyph */
+    struct ctx_glyph_run {
+        u_char  x;          /* First column of the run */
+        u_char  len;        /* Columns in the run */
+        u_char  val;        /* 0 for the outline and 255 for the body */
+    };
+
+    /* Glyph as runs so each one is drawn with a fill per row */
+    struct ctx_glyph {
+        ctx_glyph_run   run[8][7];
+        int             run_cnt[8];
+    };
+
     class cls_draw {
         public:
             cls_draw(cls_camera *p_cam);
@@ -37,16 +50,26 @@
             cls_camera *cam;
 
             u_char *char_arr_ptr[ASCII_MAX];
+            ctx_glyph glyphs[ASCII_MAX];
+            ctx_mask_spans  spans_fixed;
+            bool            spans_fixed_init;
+            ctx_mask_spans  spans_smart;
+            int             spans_smart_gen;
 
             int textn(u_char *image
                 , int startx,  int starty,  int width
                 , const char *text, int len, int factor);
             void init_chars(void);
+            void init_glyph(ctx_glyph *glyph, const u_char *pix);
             void init_scale();
             void location(ctx_coord *cent
                 , ctx_images *imgs, int width, u_char *new_var);
             void red_location(ctx_coord *cent
                 , ctx_images *imgs, int width, u_char *new_var);
+            void init_spans(ctx_mask_spans *spans, u_char *mask);
+            void free_spans(ctx_mask_spans *spans);
+            void draw_spans(ctx_mask_spans *spans, u_char *out
+                , u_char val_u, u_char val_v);
 
     };
 
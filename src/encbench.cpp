@@ -0,0 +1,396 @@
+/*
+ *    This file is part of Motion.
+ *
+ *    Motion is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Motion is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Motion.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "motion.hpp"
+#include "util.hpp"
+#include "conf.hpp"
+#include "camera.hpp"
+#include "logger.hpp"
+#include "encbench.hpp"
+
+#define ENCBENCH_FRAMES 100
+
+/* Presets timed for the encoders that have them, fastest first */
+static const char *encbench_presets[] = {
+    "ultrafast", "superfast", "veryfast", "faster", "fast", "medium", nullptr
+};
+
+/* Codecs used by the movie containers and the transport streams */
+static const enum AVCodecID encbench_codecs[] = {
+    AV_CODEC_ID_H264, AV_CODEC_ID_HEVC, AV_CODEC_ID_VP8, AV_CODEC_ID_NONE
+};
+
+/* Next registered codec.  av_codec_iterate is not in older versions */
+static const AVCodec *encbench_iterate(void **iter)
+{
+    #if (MYFFVER < 58012)
+        *iter = (void *)av_codec_next((const AVCodec *)*iter);
+        return (const AVCodec *)*iter;
+    #else
+        return av_codec_iterate(iter);
+    #endif
+}
+
+/* Largest image and total rate over the configured cameras */
+void cls_encbench::init_size()
+{
+    int indx;
+    cls_config *cfg;
+
+    width = 640;
+    height = 480;
+    fps = 15;
+    fps_need = 0;
+
+    for (indx=0; indx<app->cam_cnt; indx++) {
+        cfg = app->cam_list[indx]->cfg;
+        if ((cfg->width * cfg->height) > (width * height)) {
+            width = cfg->width;
+            height = cfg->height;
+        }
+        fps = MAX(fps, cfg->framerate);
+        fps_need += cfg->framerate;
+    }
+    if (fps_need == 0) {
+        fps_need = fps;
+    }
+    width  = (width / 16) * 16;
+    height = (height / 16) * 16;
+}
+
+/* A moving pattern so that the encoders have motion to code */
+void cls_encbench::frame_fill(AVFrame *frame, int indx)
+{
+    int x, y;
+    u_char *row;
+
+    for (y=0; y<frame->height; y++) {
+        row = frame->data[0] + (y * frame->linesize[0]);
+        for (x=0; x<frame->width; x++) {
+            row[x] = (u_char)((x + y + (indx * 4)) ^ ((x * y) >> 6));
+        }
+    }
+    for (y=0; y<(frame->height / 2); y++) {
+        memset(frame->data[1] + (y * frame->linesize[1])
+            , 128 + ((y + indx) % 32), (uint)(frame->width / 2));
+        memset(frame->data[2] + (y * frame->linesize[2])
+            , 128 - ((y + indx) % 32), (uint)(frame->width / 2));
+    }
+}
+
+/* Frames per second of the encoder or -1 if it can not be used */
+double cls_encbench::bench_one(const AVCodec *codec, std::string preset)
+{
+    AVCodecContext *ctx;
+    AVFrame *frame;
+    AVPacket *pkt;
+    struct timespec ts_st, ts_en;
+    double elapsed;
+    int indx, retcd;
+
+    ctx = avcodec_alloc_context3(codec);
+    if (ctx == nullptr) {
+        return -1;
+    }
+    ctx->width = width;
+    ctx->height = height;
+    ctx->time_base.num = 1;
+    ctx->time_base.den = fps;
+    ctx->framerate.num = fps;
+    ctx->framerate.den = 1;
+    ctx->gop_size = 15;
+    ctx->max_b_frames = 0;
+    ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    ctx->bit_rate = 2000000;
+    if (preset != "") {
+        av_opt_set(ctx->priv_data, "preset", preset.c_str(), 0);
+        av_opt_set(ctx->priv_data, "tune", "zerolatency", 0);
+    }
+    if (avcodec_open2(ctx, codec, nullptr) < 0) {
+        avcodec_free_context(&ctx);
+        return -1;
+    }
+
+    frame = av_frame_alloc();
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = width;
+    frame->height = height;
+    if (av_frame_get_buffer(frame, 32) < 0) {
+        av_frame_free(&frame);
+        avcodec_free_context(&ctx);
+        return -1;
+    }
+    pkt = av_packet_alloc();
+
+    retcd = 0;
+    clock_gettime(CLOCK_MONOTONIC, &ts_st);
+    for (indx=0; indx<=ENCBENCH_FRAMES; indx++) {
+        if (indx < ENCBENCH_FRAMES) {
+            av_frame_make_writable(frame);
+            frame_fill(frame, indx);
+            frame->pts = indx;
+            retcd = avcodec_send_frame(ctx, frame);
+        } else {
+            retcd = avcodec_send_frame(ctx, nullptr);
+        }
+        if (retcd < 0) {
+            break;
+        }
+        while (avcodec_receive_packet(ctx, pkt) == 0) {
+            av_packet_unref(pkt);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts_en);
+
+    av_packet_free(&pkt);
+    av_frame_free(&frame);
+    avcodec_free_context(&ctx);
+
+    if (retcd < 0) {
+        return -1;
+    }
+    elapsed = (double)(ts_en.tv_sec - ts_st.tv_sec) +
+        ((double)(ts_en.tv_nsec - ts_st.tv_nsec) / 1000000000.0);
+    if (elapsed <= 0) {
+        return -1;
+    }
+    return (ENCBENCH_FRAMES / elapsed);
+}
+
+/* For each codec keep the slowest preset (best quality) that still
+ * encodes all the cameras in real time.  Hardware encoders are preferred
+ * over the presets since they leave the processor for detection.
+ * When nothing is fast enough the fastest is kept.
+ */
+void cls_encbench::choose(std::vector<ctx_encbench_item> &results)
+{
+    int cdx, indx, pdx, rank, best_rank, best;
+    const AVCodec *codec;
+
+    chosen.clear();
+    for (cdx=0; encbench_codecs[cdx] != AV_CODEC_ID_NONE; cdx++) {
+        best = -1;
+        best_rank = -2;
+        for (indx=0; indx<(int)results.size(); indx++) {
+            if (results[(uint)indx].codec_id != encbench_codecs[cdx]) {
+                continue;
+            }
+            if (results[(uint)indx].fps < fps_need) {
+                rank = -2;
+            } else if (results[(uint)indx].preset != "") {
+                rank = 0;
+                for (pdx=0; encbench_presets[pdx] != nullptr; pdx++) {
+                    if (results[(uint)indx].preset == encbench_presets[pdx]) {
+                        rank = pdx;
+                    }
+                }
+            } else {
+                codec = avcodec_find_encoder_by_name(results[(uint)indx].name.c_str());
+                rank = -1;
+                #if (MYFFVER >= 58012)
+                    if ((codec != nullptr) &&
+                        (codec->capabilities & AV_CODEC_CAP_HARDWARE)) {
+                        rank = 100;
+                    }
+                #else
+                    (void)codec;
+                #endif
+            }
+            if ((best == -1) || (rank > best_rank) ||
+                ((rank == best_rank) &&
+                 (results[(uint)indx].fps > results[(uint)best].fps))) {
+                best = indx;
+                best_rank = rank;
+            }
+        }
+        if (best != -1) {
+            chosen.push_back(results[(uint)best]);
+        }
+    }
+}
+
+void cls_encbench::save()
+{
+    FILE *fp;
+    int indx;
+
+    fp = myfopen(file_nm.c_str(), "we");
+    if (fp == nullptr) {
+        return;
+    }
+    fprintf(fp, "# Written by motion --bench-encoders for %dx%d at %d fps\n"
+        , width, height, fps_need);
+    fprintf(fp, "# codec encoder preset fps\n");
+    for (indx=0; indx<(int)chosen.size(); indx++) {
+        fprintf(fp, "%s %s %s %.1f\n"
+            , avcodec_get_name(chosen[(uint)indx].codec_id)
+            , chosen[(uint)indx].name.c_str()
+            , (chosen[(uint)indx].preset == "") ? "-" : chosen[(uint)indx].preset.c_str()
+            , chosen[(uint)indx].fps);
+    }
+    myfclose(fp);
+}
+
+void cls_encbench::load()
+{
+    FILE *fp;
+    char line[256], cdc[64], enc[64], pst[64];
+    double rate;
+    int cdx;
+    ctx_encbench_item item;
+
+    chosen.clear();
+    fp = fopen(file_nm.c_str(), "re");
+    if (fp == nullptr) {
+        return;
+    }
+    while (fgets(line, sizeof(line), fp) != nullptr) {
+        if ((line[0] == '#') ||
+            (sscanf(line, "%63s %63s %63s %lf", cdc, enc, pst, &rate) != 4)) {
+            continue;
+        }
+        for (cdx=0; encbench_codecs[cdx] != AV_CODEC_ID_NONE; cdx++) {
+            if (mystreq(cdc, avcodec_get_name(encbench_codecs[cdx]))) {
+                item.codec_id = encbench_codecs[cdx];
+                item.name = enc;
+                item.preset = mystreq(pst, "-") ? "" : pst;
+                item.fps = rate;
+                chosen.push_back(item);
+                MOTION_LOG(INF, TYPE_ENCODER, NO_ERRNO
+                    , _("Benchmarked encoder for %s: %s %s")
+                    , cdc, enc, pst);
+            }
+        }
+    }
+    fclose(fp);
+}
+
+/* Time every usable encoder and record the choice for each codec */
+void cls_encbench::run()
+{
+    void *iter;
+    const AVCodec *codec;
+    int cdx, pdx;
+    bool usable;
+    std::vector<ctx_encbench_item> results;
+    ctx_encbench_item item;
+
+    init_size();
+
+    printf("Benchmarking encoders at %dx%d.  Real time for all cameras is %d fps.\n\n"
+        , width, height, fps_need);
+    printf("%-8s %-24s %-10s %10s\n", "codec", "encoder", "preset", "fps");
+
+    iter = nullptr;
+    while ((codec = encbench_iterate(&iter)) != nullptr) {
+        if ((av_codec_is_encoder(codec) == 0) ||
+            (codec->type != AVMEDIA_TYPE_VIDEO)) {
+            continue;
+        }
+        usable = false;
+        for (cdx=0; encbench_codecs[cdx] != AV_CODEC_ID_NONE; cdx++) {
+            if (codec->id == encbench_codecs[cdx]) {
+                usable = true;
+            }
+        }
+        if (usable == false) {
+            continue;
+        }
+
+        item.codec_id = codec->id;
+        item.name = codec->name;
+        if (mystrne(codec->name, "libx264") && mystrne(codec->name, "libx265")) {
+            item.preset = "";
+            item.fps = bench_one(codec, "");
+            if (item.fps > 0) {
+                results.push_back(item);
+                printf("%-8s %-24s %-10s %10.1f\n"
+                    , avcodec_get_name(codec->id), codec->name, "-", item.fps);
+            } else {
+                printf("%-8s %-24s %-10s %10s\n"
+                    , avcodec_get_name(codec->id), codec->name, "-", "unusable");
+            }
+            continue;
+        }
+        for (pdx=0; encbench_presets[pdx] != nullptr; pdx++) {
+            item.preset = encbench_presets[pdx];
+            item.fps = bench_one(codec, item.preset);
+            if (item.fps > 0) {
+                results.push_back(item);
+                printf("%-8s %-24s %-10s %10.1f\n"
+                    , avcodec_get_name(codec->id), codec->name
+                    , item.preset.c_str(), item.fps);
+            }
+        }
+    }
+
+    choose(results);
+    save();
+
+    printf("\nChosen encoders written to %s\n", file_nm.c_str());
+    for (cdx=0; cdx<(int)chosen.size(); cdx++) {
+        printf("%-8s %-24s %-10s %10.1f\n"
+            , avcodec_get_name(chosen[(uint)cdx].codec_id)
+            , chosen[(uint)cdx].name.c_str()
+            , (chosen[(uint)cdx].preset == "") ? "-" : chosen[(uint)cdx].preset.c_str()
+            , chosen[(uint)cdx].fps);
+    }
+}
+
+bool cls_encbench::get(enum AVCodecID codec_id, std::string &enc_nm, std::string &enc_preset)
+{
+    int indx;
+
+    for (indx=0; indx<(int)chosen.size(); indx++) {
+        if (chosen[(uint)indx].codec_id == codec_id) {
+            enc_nm = chosen[(uint)indx].name;
+            enc_preset = chosen[(uint)indx].preset;
+            return true;
+        }
+    }
+    return false;
+}
+
+cls_encbench::cls_encbench(cls_motapp *p_app)
+{
+    size_t lstpos;
+
+    app = p_app;
+    width = 640;
+    height = 480;
+    fps = 15;
+    fps_need = 15;
+
+    file_nm = app->cfg->encoder_file;
+    if (file_nm == "") {
+        lstpos = app->conf_src->conf_filename.find_last_of("/");
+        if (lstpos == std::string::npos) {
+            file_nm = "motion_encoder.txt";
+        } else {
+            file_nm = app->conf_src->conf_filename.substr(0, lstpos + 1)
+                + "motion_encoder.txt";
+        }
+    }
+
+    load();
+}
+
+cls_encbench::~cls_encbench()
+{
+    chosen.clear();
+}
@@ -0,0 +1,60 @@
+/*
+ *    This file is part of Motion.
+ *
+ *    Motion is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Motion is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Motion.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _INCLUDE_ENCBENCH_HPP_
+#define _INCLUDE_ENCBENCH_HPP_
+
+struct ctx_encbench_item {
+    enum AVCodecID  codec_id;
+    std::string     name;       /* Name of the encoder */
+    std::string     preset;     /* Preset used or empty */
+    double          fps;        /* Frames encoded per second */
+};
+
+/*
+ * Timing of the available encoders.  "motion --bench-encoders" encodes
+ * synthetic frames at the size and rate of the configured cameras with
+ * each encoder and preset and records the choice for each codec in
+ * encoder_file.  The movies and the transport streams then use the
+ * recorded encoder unless one is named in movie_container.
+ */
+class cls_encbench {
+    public:
+        cls_encbench(cls_motapp *p_app);
+        ~cls_encbench();
+        void run();
+        bool get(enum AVCodecID codec_id, std::string &enc_nm, std::string &enc_preset);
+
+    private:
+        cls_motapp  *app;
+        std::string file_nm;
+        std::vector<ctx_encbench_item> chosen;
+        int         width;
+        int         height;
+        int         fps;
+        int         fps_need;
+
+        void init_size();
+        void load();
+        void save();
+        void frame_fill(AVFrame *frame, int indx);
+        double bench_one(const AVCodec *codec, std::string preset);
+        void choose(std::vector<ctx_encbench_item> &results);
+};
+
+#endif /* _INCLUDE_ENCBENCH_HPP_ */
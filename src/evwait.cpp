@@ -0,0 +1,171 @@
+/*
+ *    This file is part of Motion.
+ *
+ *    Motion is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Motion is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Motion.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "motion.hpp"
+#include "util.hpp"
+#include "logger.hpp"
+#include "evwait.hpp"
+#include <poll.h>
+#if defined(HAVE_SYS_TIMERFD_H) && defined(HAVE_SYS_EVENTFD_H)
+    #include <sys/timerfd.h>
+    #include <sys/eventfd.h>
+#endif
+
+/* Empty a non blocking descriptor so the next poll blocks again */
+void cls_evwait::drain(int fd)
+{
+    char buf[64];
+
+    while (read(fd, buf, sizeof(buf)) > 0) {
+    }
+}
+
+/* Post a wake up.  Only uses write so it is safe from a signal handler */
+void cls_evwait::wake()
+{
+    #if defined(HAVE_SYS_TIMERFD_H) && defined(HAVE_SYS_EVENTFD_H)
+        uint64_t val = 1;
+        if (write(fd_wake_wr, &val, sizeof(val)) < 0) {
+            return;
+        }
+    #else
+        char val = 1;
+        if (write(fd_wake_wr, &val, 1) < 0) {
+            return;
+        }
+    #endif
+}
+
+/*
+ * Wait for a wake up or until the monotonic deadline passes.  A null
+ * deadline waits only for a wake up.  Returns true when woken.
+ */
+bool cls_evwait::wait_until(const struct timespec *deadline)
+{
+    struct pollfd pfd[2];
+    int retcd, tmo;
+
+    pfd[0].fd = fd_wake;
+    pfd[0].events = POLLIN;
+    pfd[0].revents = 0;
+    pfd[1].fd = fd_timer;
+    pfd[1].events = POLLIN;
+    pfd[1].revents = 0;
+    tmo = -1;
+
+    if (fd_timer != -1) {
+        #if defined(HAVE_SYS_TIMERFD_H) && defined(HAVE_SYS_EVENTFD_H)
+            struct itimerspec its;
+
+            memset(&its, 0, sizeof(its));
+            if (deadline != nullptr) {
+                its.it_value = *deadline;
+                /* A zero value would disarm the timer rather than fire */
+                if ((its.it_value.tv_sec == 0) && (its.it_value.tv_nsec == 0)) {
+                    its.it_value.tv_nsec = 1;
+                }
+            }
+            timerfd_settime(fd_timer, TFD_TIMER_ABSTIME, &its, nullptr);
+        #endif
+    } else if (deadline != nullptr) {
+        struct timespec ts;
+        int64_t remain;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        remain = ((deadline->tv_sec - ts.tv_sec) * 1000) +
+            ((deadline->tv_nsec - ts.tv_nsec + 999999) / 1000000);
+        tmo = (int)MAX(0, MIN(remain, INT_MAX));
+    } else if (fd_wake == -1) {
+        /* Nothing could ever end the wait */
+        tmo = 1000;
+    }
+
+    do {
+        retcd = poll(pfd, (fd_timer == -1) ? 1 : 2, tmo);
+    } while ((retcd == -1) && (errno == EINTR));
+
+    if (retcd <= 0) {
+        return false;
+    }
+    if (pfd[1].revents & POLLIN) {
+        drain(fd_timer);
+    }
+    if (pfd[0].revents & POLLIN) {
+        drain(fd_wake);
+        return true;
+    }
+    return false;
+}
+
+/* Wait for a wake up or the relative interval */
+bool cls_evwait::wait_for(time_t sec, long nsec)
+{
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += sec + (nsec / 1000000000L);
+    deadline.tv_nsec += (nsec % 1000000000L);
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return wait_until(&deadline);
+}
+
+cls_evwait::cls_evwait()
+{
+    fd_wake = -1;
+    fd_wake_wr = -1;
+    fd_timer = -1;
+
+    #if defined(HAVE_SYS_TIMERFD_H) && defined(HAVE_SYS_EVENTFD_H)
+        fd_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        fd_wake_wr = fd_wake;
+        fd_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if ((fd_wake == -1) || (fd_timer == -1)) {
+            MOTION_LOG(ERR, TYPE_ALL, SHOW_ERRNO
+                , _("Unable to create eventfd/timerfd"));
+        }
+    #else
+        int fds[2];
+        if (pipe(fds) == 0) {
+            fd_wake = fds[0];
+            fd_wake_wr = fds[1];
+            fcntl(fd_wake, F_SETFL, O_NONBLOCK);
+            fcntl(fd_wake_wr, F_SETFL, O_NONBLOCK);
+            fcntl(fd_wake, F_SETFD, FD_CLOEXEC);
+            fcntl(fd_wake_wr, F_SETFD, FD_CLOEXEC);
+        } else {
+            MOTION_LOG(ERR, TYPE_ALL, SHOW_ERRNO
+                , _("Unable to create wake pipe"));
+        }
+    #endif
+}
+
+cls_evwait::~cls_evwait()
+{
+    if (fd_timer != -1) {
+        close(fd_timer);
+    }
+    if ((fd_wake_wr != -1) && (fd_wake_wr != fd_wake)) {
+        close(fd_wake_wr);
+    }
+    if (fd_wake != -1) {
+        close(fd_wake);
+    }
+}
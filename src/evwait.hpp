@@ -0,0 +1,45 @@
+/*
+ *    This file is part of Motion.
+ *
+ *    Motion is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Motion is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Motion.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _INCLUDE_EVWAIT_HPP_
+#define _INCLUDE_EVWAIT_HPP_
+
+/*
+ * Blocking wait used by the background threads in place of sleep
+ * loops.  A thread sleeps until either an absolute CLOCK_MONOTONIC
+ * deadline expires or another thread (or a signal handler) calls
+ * wake().  Wakes posted before the wait starts are not lost.
+ */
+class cls_evwait {
+    public:
+        cls_evwait();
+        ~cls_evwait();
+
+        void wake();
+        bool wait_until(const struct timespec *deadline);
+        bool wait_for(time_t sec, long nsec);
+
+    private:
+        int     fd_wake;        /* eventfd, or read end of the pipe */
+        int     fd_wake_wr;     /* Write end used by wake() */
+        int     fd_timer;       /* timerfd for the deadline or -1 */
+
+        void drain(int fd);
+};
+
+#endif /*_INCLUDE_EVWAIT_HPP_*/
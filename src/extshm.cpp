@@ -0,0 +1,268 @@
+/*
+ *    This file is part of Motion.
+ *
+ *    Motion is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Motion is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Motion.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "motion.hpp"
+#include "util.hpp"
+#include "logger.hpp"
+#include "extshm.hpp"
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#if defined(HAVE_SYS_EVENTFD_H)
+    #include <sys/eventfd.h>
+#endif
+
+/* Create the memfd and the eventfds.  They are close-on-exec so that
+ * no other command started by Motion inherits them.
+ */
+int cls_extshm::open(int p_width, int p_height, int p_fps, size_t p_frame_size, int p_slots)
+{
+    #if defined(HAVE_MEMFD_CREATE) && defined(HAVE_SYS_EVENTFD_H)
+        size_t pgsz, slot_size;
+        int slots;
+
+        close();
+
+        slots = MAX(2, MIN(p_slots, EXTSHM_SLOTS_MAX));
+        pgsz = (size_t)sysconf(_SC_PAGESIZE);
+        slot_size = ((p_frame_size + pgsz - 1) / pgsz) * pgsz;
+        map_sz = EXTSHM_HDR_SIZE + (slot_size * (size_t)slots);
+
+        fd_shm = memfd_create("motion-extpipe", MFD_CLOEXEC);
+        if (fd_shm == -1) {
+            MOTION_LOG(ERR, TYPE_EVENTS, SHOW_ERRNO, _("memfd_create failed"));
+            return -1;
+        }
+        if (ftruncate(fd_shm, (off_t)map_sz) == -1) {
+            MOTION_LOG(ERR, TYPE_EVENTS, SHOW_ERRNO, _("Unable to size shared memory"));
+            close();
+            return -1;
+        }
+        base = (u_char *)mmap(nullptr, map_sz, PROT_READ | PROT_WRITE
+            , MAP_SHARED, fd_shm, 0);
+        if (base == MAP_FAILED) {
+            MOTION_LOG(ERR, TYPE_EVENTS, SHOW_ERRNO, _("Unable to map shared memory"));
+            base = nullptr;
+            close();
+            return -1;
+        }
+        fd_data = eventfd(0, EFD_CLOEXEC);
+        fd_free = eventfd(0, EFD_CLOEXEC);
+        if ((fd_data == -1) || (fd_free == -1)) {
+            MOTION_LOG(ERR, TYPE_EVENTS, SHOW_ERRNO, _("eventfd failed"));
+            close();
+            return -1;
+        }
+
+        hdr = (ctx_extshm_hdr *)base;
+        memset(hdr, 0, sizeof(ctx_extshm_hdr));
+        memcpy(hdr->magic, EXTSHM_MAGIC, sizeof(EXTSHM_MAGIC));
+        hdr->version = EXTSHM_VERSION;
+        hdr->hdr_size = EXTSHM_HDR_SIZE;
+        hdr->slot_cnt = (uint32_t)slots;
+        hdr->slot_size = (uint32_t)slot_size;
+        hdr->frame_size = (uint32_t)p_frame_size;
+        hdr->width = (uint32_t)p_width;
+        hdr->height = (uint32_t)p_height;
+        hdr->fps = (uint32_t)p_fps;
+
+        frame_size = p_frame_size;
+
+        return 0;
+    #else
+        (void)p_width;
+        (void)p_height;
+        (void)p_fps;
+        (void)p_frame_size;
+        (void)p_slots;
+        MOTION_LOG(ERR, TYPE_EVENTS, NO_ERRNO
+            , _("Shared memory extpipe is not available on this system"));
+        return -1;
+    #endif
+}
+
+void cls_extshm::close()
+{
+    if (base != nullptr) {
+        munmap(base, map_sz);
+        base = nullptr;
+    }
+    hdr = nullptr;
+    if (fd_shm != -1) {
+        ::close(fd_shm);
+        fd_shm = -1;
+    }
+    if (fd_data != -1) {
+        ::close(fd_data);
+        fd_data = -1;
+    }
+    if (fd_free != -1) {
+        ::close(fd_free);
+        fd_free = -1;
+    }
+}
+
+bool cls_extshm::is_open()
+{
+    return (hdr != nullptr);
+}
+
+/* Variables placed in front of the command for the shell */
+std::string cls_extshm::env()
+{
+    return "MOTION_SHM_FD=" + std::to_string(fd_shm) +
+        " MOTION_SHM_DATA_FD=" + std::to_string(fd_data) +
+        " MOTION_SHM_FREE_FD=" + std::to_string(fd_free) + " ";
+}
+
+/*
+ * Start the command with a pipe to its stdin as popen would.  The
+ * close-on-exec flag of the descriptors is only cleared in the child
+ * between fork and exec so no other command can inherit them.
+ */
+FILE *cls_extshm::cmd_open(std::string cmd)
+{
+    int fd_pipe[2];
+    FILE *fp;
+    const char *cmd_str;
+
+    if (pipe2(fd_pipe, O_CLOEXEC) == -1) {
+        return nullptr;
+    }
+
+    cmd_str = cmd.c_str();
+    cmd_pid = fork();
+    if (cmd_pid == -1) {
+        ::close(fd_pipe[0]);
+        ::close(fd_pipe[1]);
+        return nullptr;
+    }
+
+    if (cmd_pid == 0) {
+        /* Only async-signal-safe calls in the child */
+        if (dup2(fd_pipe[0], STDIN_FILENO) == -1) {
+            _exit(127);
+        }
+        fcntl(fd_shm, F_SETFD, 0);
+        fcntl(fd_data, F_SETFD, 0);
+        fcntl(fd_free, F_SETFD, 0);
+        execl("/bin/sh", "sh", "-c", cmd_str, (char *)nullptr);
+        _exit(127);
+    }
+
+    ::close(fd_pipe[0]);
+    fp = fdopen(fd_pipe[1], "w");
+    if (fp == nullptr) {
+        ::close(fd_pipe[1]);
+        cmd_close(nullptr);
+    }
+    return fp;
+}
+
+/* Close the stdin of the command and wait for it to end */
+int cls_extshm::cmd_close(FILE *fp)
+{
+    int status;
+
+    if (fp != nullptr) {
+        fclose(fp);
+    }
+    if (cmd_pid <= 0) {
+        return -1;
+    }
+    while (waitpid(cmd_pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            status = -1;
+            break;
+        }
+    }
+    cmd_pid = -1;
+    return status;
+}
+
+/* Copy the frame into the next slot and post it to the command.
+ * This runs on the camera thread so it never waits.  Returns 1 when
+ * the ring is full and the frame was dropped.
+ */
+int cls_extshm::put(u_char *image, const struct timespec *ts1)
+{
+    uint64_t wr, rd, cnt;
+    uint32_t slot;
+    struct pollfd pfd;
+
+    if (hdr == nullptr) {
+        return -1;
+    }
+
+    wr = hdr->write_seq;
+    rd = __atomic_load_n(&hdr->read_seq, __ATOMIC_ACQUIRE);
+    if ((wr - rd) >= hdr->slot_cnt) {
+        /* Clear the posts of the command and check the ring once more */
+        pfd.fd = fd_free;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 0) > 0) {
+            if (read(fd_free, &cnt, sizeof(cnt)) != sizeof(cnt)) {
+                cnt = 0;
+            }
+        }
+        rd = __atomic_load_n(&hdr->read_seq, __ATOMIC_ACQUIRE);
+        if ((wr - rd) >= hdr->slot_cnt) {
+            hdr->dropped++;
+            return 1;
+        }
+    }
+
+    slot = (uint32_t)(wr % hdr->slot_cnt);
+    memcpy(base + hdr->hdr_size + ((size_t)slot * hdr->slot_size), image, frame_size);
+    hdr->slot[slot].seq = wr;
+    hdr->slot[slot].ts_us = ((int64_t)ts1->tv_sec * 1000000L) + (ts1->tv_nsec / 1000);
+    __atomic_store_n(&hdr->write_seq, wr + 1, __ATOMIC_RELEASE);
+
+    cnt = 1;
+    if (write(fd_data, &cnt, sizeof(cnt)) != sizeof(cnt)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int64_t cls_extshm::dropped()
+{
+    if (hdr == nullptr) {
+        return 0;
+    }
+    return (int64_t)hdr->dropped;
+}
+
+cls_extshm::cls_extshm()
+{
+    fd_shm = -1;
+    fd_data = -1;
+    fd_free = -1;
+    cmd_pid = -1;
+    base = nullptr;
+    hdr = nullptr;
+    map_sz = 0;
+    frame_size = 0;
+}
+
+cls_extshm::~cls_extshm()
+{
+    close();
+}
@@ -0,0 +1,94 @@
+/*
+ *    This file is part of Motion.
+ *
+ *    Motion is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Motion is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Motion.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _INCLUDE_EXTSHM_HPP_
+#define _INCLUDE_EXTSHM_HPP_
+
+/*
+ * Shared memory ring for the extpipe.  Instead of writing each frame
+ * into the stdin of the extpipe command, the frames are copied into a
+ * memfd that the command maps.  The command receives three inherited
+ * descriptors in its environment:
+ *
+ *   MOTION_SHM_FD       memfd with the header followed by the slots
+ *   MOTION_SHM_DATA_FD  eventfd posted by Motion after each frame
+ *   MOTION_SHM_FREE_FD  eventfd posted by the command after it reads
+ *
+ * Frame n (counting from zero) is in slot n % slot_cnt at byte offset
+ * hdr_size + (slot * slot_size) and is frame_size bytes of YUV420P.
+ * Motion publishes a frame by storing write_seq = n + 1 with release
+ * order.  The command reads frames read_seq..write_seq-1, stores the
+ * new read_seq with release order and posts MOTION_SHM_FREE_FD.  A
+ * slot is never reused until read_seq has passed it; when the ring is
+ * full the frame is dropped at once and counted.
+ * The stdin of the command is closed at the end of the movie.  The
+ * descriptors are close-on-exec in Motion and only the command started
+ * by cmd_open inherits them.
+ */
+
+#define EXTSHM_MAGIC        "MOTSHM1"
+#define EXTSHM_VERSION      1
+#define EXTSHM_HDR_SIZE     4096
+#define EXTSHM_SLOTS_MAX    64
+
+struct ctx_extshm_slot {
+    uint64_t    seq;            /* Frame number held by the slot */
+    int64_t     ts_us;          /* Capture time in microseconds since the epoch */
+};
+
+struct ctx_extshm_hdr {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    hdr_size;
+    uint32_t    slot_cnt;
+    uint32_t    slot_size;
+    uint32_t    frame_size;
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    fps;
+    uint64_t    write_seq;      /* Frames published by Motion */
+    uint64_t    read_seq;       /* Frames released by the command */
+    uint64_t    dropped;        /* Frames dropped on a full ring */
+    ctx_extshm_slot slot[EXTSHM_SLOTS_MAX];
+};
+
+class cls_extshm {
+    public:
+        cls_extshm();
+        ~cls_extshm();
+        int open(int p_width, int p_height, int p_fps, size_t p_frame_size, int p_slots);
+        void close();
+        bool is_open();
+        std::string env();
+        FILE *cmd_open(std::string cmd);
+        int cmd_close(FILE *fp);
+        int put(u_char *image, const struct timespec *ts1);
+        int64_t dropped();
+
+    private:
+        int             fd_shm;
+        int             fd_data;
+        int             fd_free;
+        pid_t           cmd_pid;
+        u_char          *base;
+        size_t          map_sz;
+        size_t          frame_size;
+        ctx_extshm_hdr  *hdr;
+};
+
+#endif /* _INCLUDE_EXTSHM_HPP_ */
@@ -912,7 +912,20 @@ int cls_libcam::start_config()
     MOTION_LOG(NTC, TYPE_VIDEO, NO_ERRNO, "Starting.");
 
     /* Pi 5 requires VideoRecording role for proper PiSP pipeline initialization */
-    config = camera->generateConfiguration({ StreamRole::VideoRecording });
+    lores = ((cam->cfg->libcam_lores_width > 0) &&
+        (cam->cfg->libcam_lores_height > 0));
+    if (lores) {
+        config = camera->generateConfiguration(
+            { StreamRole::VideoRecording, StreamRole::Viewfinder });
+        if ((config == nullptr) || (config->size() < 2)) {
+            MOTION_LOG(WRN, TYPE_VIDEO, NO_ERRNO
+                , "Camera does not provide a second stream.  Using one stream");
+            lores = false;
+        }
+    }
+    if (lores == false) {
+        config = camera->generateConfiguration({ StreamRole::VideoRecording });
+    }
 
     config->at(0).pixelFormat = PixelFormat::fromString("YUV420");
 
@@ -931,6 +944,15 @@ int cls_libcam::start_config()
 
     config->at(0).stride = 0;
 
+    /* The ISP scales the detection stream so it is never done in software */
+    if (lores) {
+        config->at(1).pixelFormat = PixelFormat::fromString("YUV420");
+        config->at(1).size.width = (uint)cam->cfg->libcam_lores_width;
+        config->at(1).size.height = (uint)cam->cfg->libcam_lores_height;
+        config->at(1).bufferCount = (uint)buffer_count;
+        config->at(1).stride = 0;
+    }
+
     /* DIAGNOSTIC: Log pre-validate configuration */
     MOTION_LOG(NTC, TYPE_VIDEO, NO_ERRNO
         , "DIAG: Pre-validate config: requested=%dx%d, pixelFormat=%s, bufferCount=%d"
@@ -980,6 +1002,15 @@ int cls_libcam::start_config()
         return -1;
     }
 
+    if (lores &&
+        (config->at(1).pixelFormat != PixelFormat::fromString("YUV420")) &&
+        (config->at(1).pixelFormat != PixelFormat::fromString("NV12"))) {
+        MOTION_LOG(ERR, TYPE_VIDEO, NO_ERRNO
+            , "Unsupported pixel format for the low resolution stream: %s"
+            , config->at(1).pixelFormat.toString().c_str());
+        return -1;
+    }
+
     if ((config->at(0).size.width != (uint)cam->cfg->width) ||
         (config->at(0).size.height != (uint)cam->cfg->height)) {
         MOTION_LOG(NTC, TYPE_VIDEO, NO_ERRNO
@@ -988,8 +1019,21 @@ int cls_libcam::start_config()
             , config->at(0).size.width, config->at(0).size.height);
     }
 
-    cam->imgs.width = (int)config->at(0).size.width;
-    cam->imgs.height = (int)config->at(0).size.height;
+    if (lores) {
+        /* Rows padded by the ISP are kept as part of the image */
+        cam->imgs.width_high = (int)MAX(config->at(0).size.width, config->at(0).stride);
+        cam->imgs.height_high = (int)config->at(0).size.height;
+        cam->imgs.size_high = (cam->imgs.width_high * cam->imgs.height_high * 3) / 2;
+        cam->imgs.width = (int)MAX(config->at(1).size.width, config->at(1).stride);
+        cam->imgs.height = (int)config->at(1).size.height;
+        MOTION_LOG(NTC, TYPE_VIDEO, NO_ERRNO
+            , "Detection stream %d x %d, movie and picture stream %d x %d"
+            , config->at(1).size.width, config->at(1).size.height
+            , config->at(0).size.width, config->at(0).size.height);
+    } else {
+        cam->imgs.width = (int)config->at(0).size.width;
+        cam->imgs.height = (int)config->at(0).size.height;
+    }
     cam->imgs.size_norm = (cam->imgs.width * cam->imgs.height * 3) / 2;
     cam->imgs.motionsize = cam->imgs.width * cam->imgs.height;
 
@@ -1132,6 +1176,15 @@ int cls_libcam::start_req()
     MOTION_LOG(NTC, TYPE_VIDEO, NO_ERRNO
         , "Allocated %d buffers for stream", (int)buffers.size());
 
+    if (lores) {
+        retcd = frmbuf->allocate(config->at(1).stream());
+        if ((retcd < 0) || ((size_t)retcd < buffers.size())) {
+            MOTION_LOG(ERR, TYPE_VIDEO, NO_ERRNO
+                , "Buffer allocation error for the low resolution stream.");
+            return -1;
+        }
+    }
+
     /* Create a request for each buffer in the pool */
     for (buf_idx = 0; buf_idx < buffers.size(); buf_idx++) {
         std::unique_ptr<Request> request = camera->createRequest();
@@ -1148,6 +1201,16 @@ int cls_libcam::start_req()
             return -1;
         }
 
+        if (lores) {
+            retcd = request->addBuffer(config->at(1).stream()
+                , frmbuf->buffers(config->at(1).stream())[buf_idx].get());
+            if (retcd < 0) {
+                MOTION_LOG(ERR, TYPE_VIDEO, NO_ERRNO
+                    , "Add low resolution buffer %d for request error.", buf_idx);
+                return -1;
+            }
+        }
+
         requests.push_back(std::move(request));
     }
 
@@ -1173,7 +1236,7 @@ int cls_libcam::start_req()
         , (int)buffer->planes().size());
 
     /* Adjust image dimensions if buffer size doesn't match expected */
-    if (bytes > cam->imgs.size_norm) {
+    if ((lores == false) && (bytes > cam->imgs.size_norm)) {
         width = ((int)buffer->planes()[0].length / cam->imgs.height);
         if (((int)buffer->planes()[0].length != (width * cam->imgs.height)) ||
             (bytes > ((width * cam->imgs.height * 3) / 2))) {
@@ -1201,7 +1264,30 @@ int cls_libcam::start_req()
     membuf.bufsz = bytes;
 
     /* Map memory for each buffer in the pool */
-    membuf_pool.clear();
+    if (map_buffers(stream, membuf_pool) != 0) {
+        return -1;
+    }
+    if (lores && (map_buffers(config->at(1).stream(), membuf_lores) != 0)) {
+        return -1;
+    }
+
+    lend_check();
+
+    MOTION_LOG(NTC, TYPE_VIDEO, NO_ERRNO
+        , "Finished. Created %d requests with %d mapped buffers."
+        , (int)requests.size(), (int)membuf_pool.size());
+
+    return 0;
+}
+
+/* Map each buffer of the stream into the pool */
+int cls_libcam::map_buffers(Stream *stream, std::vector<ctx_imgmap> &pool)
+{
+    const std::vector<std::unique_ptr<FrameBuffer>> &buffers =
+        frmbuf->buffers(stream);
+    unsigned int buf_idx;
+
+    pool.clear();
     for (buf_idx = 0; buf_idx < buffers.size(); buf_idx++) {
         ctx_imgmap map;
         const FrameBuffer::Plane &p0 = buffers[buf_idx]->planes()[0];
@@ -1211,7 +1297,8 @@ int cls_libcam::start_req()
             buf_bytes += plane.length;
         }
 
-        map.buf = (uint8_t *)mmap(NULL, buf_bytes, PROT_READ
+        /* Writable so ring images can be drawn on while lent */
+        map.buf = (uint8_t *)mmap(NULL, buf_bytes, PROT_READ | PROT_WRITE
             , MAP_SHARED, p0.fd.get(), 0);
         map.bufsz = buf_bytes;
 
@@ -1221,18 +1308,81 @@ int cls_libcam::start_req()
             return -1;
         }
 
-        membuf_pool.push_back(map);
+        pool.push_back(map);
         MOTION_LOG(DBG, TYPE_VIDEO, NO_ERRNO
             , "Mapped buffer %d: %d bytes", buf_idx, buf_bytes);
     }
 
-    MOTION_LOG(NTC, TYPE_VIDEO, NO_ERRNO
-        , "Finished. Created %d requests with %d mapped buffers."
-        , (int)requests.size(), (int)membuf_pool.size());
-
     return 0;
 }
 
+/*
+ * Decide whether ring images may read the mapped buffers in place.
+ * The planes must be packed back to back in one buffer exactly as the
+ * ring images are laid out, and enough requests must stay queued with
+ * the camera while ring images hold the rest.
+ */
+void cls_libcam::lend_check()
+{
+    Stream *stream = config->at(lores ? 1 : 0).stream();
+    const std::vector<std::unique_ptr<FrameBuffer>> &buffers =
+        frmbuf->buffers(stream);
+    size_t indx, offset;
+
+    lent.clear();
+    lend_ok = (config->at(lores ? 1 : 0).pixelFormat == PixelFormat::fromString("YUV420"));
+    lend_max = (int)buffers.size() - 2;
+    if (lend_max < 1) {
+        lend_ok = false;
+    }
+
+    for (const std::unique_ptr<FrameBuffer> &buffer : buffers) {
+        const std::vector<FrameBuffer::Plane> &planes = buffer->planes();
+        offset = planes[0].offset;
+        for (indx = 0; indx < planes.size(); indx++) {
+            if ((planes[indx].fd.get() != planes[0].fd.get()) ||
+                (planes[indx].offset != offset)) {
+                lend_ok = false;
+            }
+            offset += planes[indx].length;
+        }
+        if ((planes[0].offset != 0) ||
+            (offset != (size_t)cam->imgs.size_norm)) {
+            lend_ok = false;
+        }
+    }
+
+    if (lend_ok) {
+        MOTION_LOG(NTC, TYPE_VIDEO, NO_ERRNO
+            , "Ring images read up to %d buffers without copying", lend_max);
+    }
+}
+
+/* The ring image is being reused so return its buffer to the camera */
+void cls_libcam::lend_release(ctx_image_data *img_data)
+{
+    size_t indx;
+
+    for (indx = 0; indx < lent.size(); indx++) {
+        if (lent[indx].img_data == img_data) {
+            img_data->image_norm = lent[indx].image_own;
+            lent[indx].request->reuse(Request::ReuseBuffers);
+            req_add(lent[indx].request);
+            lent.erase(lent.begin() + (long)indx);
+            return;
+        }
+    }
+}
+
+/* Give the ring images back their own memory before the buffers go away */
+void cls_libcam::lend_release_all()
+{
+    for (ctx_imglend &itm : lent) {
+        itm.img_data->image_norm = itm.image_own;
+    }
+    lent.clear();
+}
+
 int cls_libcam::start_capture()
 {
     int retcd;
@@ -1338,6 +1488,8 @@ void cls_libcam::libcam_stop()
 {
     mydelete(params);
 
+    lend_release_all();
+
     if (started_aqr) {
         camera->stop();
     }
@@ -1349,7 +1501,19 @@ void cls_libcam::libcam_stop()
         }
         requests.clear();
 
+        for (ctx_imgmap &map : membuf_pool) {
+            munmap(map.buf, map.bufsz);
+        }
+        membuf_pool.clear();
+        for (ctx_imgmap &map : membuf_lores) {
+            munmap(map.buf, map.bufsz);
+        }
+        membuf_lores.clear();
+
         frmbuf->free(config->at(0).stream());
+        if (lores) {
+            frmbuf->free(config->at(1).stream());
+        }
         frmbuf.reset();
     }
 
@@ -1646,6 +1810,9 @@ int cls_libcam::next(ctx_image_data *img_data)
 
         cam->watchdog = cam->cfg->watchdog_tmo;
 
+        /* Whatever the ring image held is no longer needed */
+        lend_release(img_data);
+
         if (!req_queue.empty()) {
             /* Get request info including buffer index */
             ctx_reqinfo req_info = req_queue.front();
@@ -1654,19 +1821,38 @@ int cls_libcam::next(ctx_image_data *img_data)
             Request *request = req_info.request;
             int buf_idx = req_info.buffer_idx;
 
-            /* Copy frame data from the correct buffer in the pool */
-            if (buf_idx >= 0 && buf_idx < (int)membuf_pool.size()) {
-                memcpy(img_data->image_norm,
+            /* With two streams the full resolution one is only for output */
+            std::vector<ctx_imgmap> &pool = (lores ? membuf_lores : membuf_pool);
+            if (lores && (buf_idx >= 0) && (buf_idx < (int)membuf_pool.size())) {
+                memcpy(img_data->image_high,
                        membuf_pool[(size_t)buf_idx].buf,
-                       membuf_pool[(size_t)buf_idx].bufsz);
-            } else {
-                /* Fallback to legacy single buffer for compatibility */
-                memcpy(img_data->image_norm, membuf.buf, membuf.bufsz);
+                       MIN(membuf_pool[(size_t)buf_idx].bufsz, (size_t)cam->imgs.size_high));
             }
 
-            /* Requeue request for next frame */
-            request->reuse(Request::ReuseBuffers);
-            req_add(request);
+            if (lend_ok && (buf_idx >= 0) && (buf_idx < (int)pool.size()) &&
+                ((int)lent.size() < lend_max)) {
+                /* The ring image reads the buffer until it is reused */
+                ctx_imglend itm;
+                itm.img_data = img_data;
+                itm.image_own = img_data->image_norm;
+                itm.request = request;
+                lent.push_back(itm);
+                img_data->image_norm = pool[(size_t)buf_idx].buf;
+            } else {
+                /* Copy frame data from the correct buffer in the pool */
+                if (buf_idx >= 0 && buf_idx < (int)pool.size()) {
+                    memcpy(img_data->image_norm,
+                           pool[(size_t)buf_idx].buf,
+                           MIN(pool[(size_t)buf_idx].bufsz, (size_t)cam->imgs.size_norm));
+                } else if (lores == false) {
+                    /* Fallback to legacy single buffer for compatibility */
+                    memcpy(img_data->image_norm, membuf.buf, membuf.bufsz);
+                }
+
+                /* Requeue request for next frame */
+                request->reuse(Request::ReuseBuffers);
+                req_add(request);
+            }
 
             cam->rotate->process(img_data);
             reconnect_count = 0;
@@ -1693,6 +1879,9 @@ cls_libcam::cls_libcam(cls_camera *p_cam)
         params = nullptr;
         cam_controls = nullptr;
         reconnect_count = 0;
+        lend_ok = false;
+        lend_max = 0;
+        lores = false;
         /* Initialize pending controls with config values */
         pending_ctrls.brightness = cam->cfg->parm_cam.libcam_brightness;
         pending_ctrls.contrast = cam->cfg->parm_cam.libcam_contrast;
@@ -36,6 +36,13 @@
             size_t  bufsz;  /* Changed to size_t for 64-bit safety */
         };
 
+        /* Ring image reading a mapped buffer in place of its own memory */
+        struct ctx_imglend {
+            ctx_image_data      *img_data;
+            u_char              *image_own;     /* Memory of the ring image while lent */
+            libcamera::Request  *request;       /* Requeued when the ring image is reused */
+        };
+
         /* Request with associated buffer index for multi-buffer support */
         struct ctx_reqinfo {
             libcamera::Request *request;
@@ -106,7 +113,11 @@
                 libcamera::ControlList             controls;
                 ctx_imgmap                         membuf;         /* Legacy single buffer (kept for compatibility) */
                 std::vector<ctx_imgmap>            membuf_pool;    /* NEW: Multi-buffer pool */
+                std::vector<ctx_imgmap>            membuf_lores;   /* Buffers of the detection stream */
                 ctx_pending_controls               pending_ctrls;  /* Hot-reload brightness/contrast */
+                std::vector<ctx_imglend>           lent;           /* Buffers held by ring images */
+                bool                               lend_ok;        /* Buffers hold a packed YUV420 image */
+                int                                lend_max;       /* Buffers that may be held at once */
 
                 /* Capability discovery storage */
                 const libcamera::ControlInfoMap   *cam_controls;   /* Pointer to camera's supported controls */
@@ -116,6 +127,7 @@
                 bool    started_mgr;
                 bool    started_aqr;
                 bool    started_req;
+                bool    lores;          /* Second stream feeds image_norm */
                 int     reconnect_count;
                 void log_orientation();
                 void log_controls();
@@ -128,6 +140,7 @@
                 int start_mgr();
                 int start_config();
                 int start_req();
+                int map_buffers(libcamera::Stream *stream, std::vector<ctx_imgmap> &pool);
                 int start_capture();
                 void config_orientation();
                 void config_controls();
@@ -135,6 +148,9 @@
                 void discover_capabilities();  /* Query camera for supported controls */
                 void req_complete(libcamera::Request *request);
                 int req_add(libcamera::Request *request);
+                void lend_check();
+                void lend_release(ctx_image_data *img_data);
+                void lend_release_all();
                 void apply_pending_controls();
 
                 /* NEW: Pi 5 camera filtering and selection */
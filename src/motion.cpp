@@ -21,16 +21,19 @@
 #include "conf.hpp"
 #include "logger.hpp"
 #include "allcam.hpp"
-#include "schedule.hpp"
 #include "camera.hpp"
 #include "sound.hpp"
 #include "dbse.hpp"
+#include "schedule.hpp"
+#include "evwait.hpp"
+#include "encbench.hpp"
 #include "webu.hpp"
 #include "video_v4l2.hpp"
 #include "movie.hpp"
 #include "netcam.hpp"
 
 volatile enum MOTION_SIGNAL motsignal;
+static cls_evwait *motevwait = nullptr;
 
 /** Handle signals sent */
 static void sig_handler(int signo)
@@ -59,6 +62,9 @@ static void sig_handler(int signo)
         pthread_exit(NULL);
         break;
     }
+    if (motevwait != nullptr) {
+        motevwait->wake();
+    }
 }
 
 /**  POSIX compliant replacement of the signal(SIGCHLD, SIG_IGN). */
@@ -136,6 +142,7 @@ void cls_motapp::signal_process()
         dbse->finish = true;
         dbse->restart = false;
         dbse->handler_stop = true;
+        dbse->wake();
 
         for (indx=0; indx<snd_cnt; indx++) {
             snd_list[indx]->restart = false;
@@ -508,6 +515,9 @@ void cls_motapp::init(int p_argc, char *p_argv[])
     webu = nullptr;
     allcam = nullptr;
     schedule = nullptr;
+    encbench = nullptr;
+    v4l2poll = nullptr;
+    bench_encoders = false;
     cam_list.clear();
     snd_list.clear();
 
@@ -527,6 +537,13 @@ void cls_motapp::init(int p_argc, char *p_argv[])
 
     mytranslate_text("",cfg->native_language);
 
+    if (bench_encoders) {
+        av_init();
+        encbench = new cls_encbench(this);
+        encbench->run();
+        exit(0);
+    }
+
     if (cfg->daemon) {
         daemon();
         MOTION_LOG(NTC, TYPE_ALL, NO_ERRNO, _("Motion running as daemon process"));
@@ -540,6 +557,8 @@ void cls_motapp::init(int p_argc, char *p_argv[])
 
     av_init();
 
+    encbench = new cls_encbench(this);
+    v4l2poll = new cls_v4l2poll(this);
     dbse = new cls_dbse(this);
     webu = new cls_webu(this);
     allcam = new cls_allcam(this);
@@ -572,6 +591,8 @@ void cls_motapp::deinit()
     mydelete(dbse);
     mydelete(allcam)
     mydelete(schedule)
+    mydelete(encbench);
+    mydelete(v4l2poll);
     mydelete(conf_src);
     mydelete(cfg);
 
@@ -659,7 +680,7 @@ int main (int p_argc, char **p_argv)
     while (true) {
         app->init(p_argc, p_argv);
         while (app->check_devices()) {
-            SLEEP(1, 0);
+            app->evwait->wait_for(1, 0);
             if (motsignal != MOTION_SIGNAL_NONE) {
                 app->signal_process();
             }
@@ -686,12 +707,20 @@ int main (int p_argc, char **p_argv)
     return 0;
 }
 
-cls_motapp::cls_motapp()
+/* Wake the main loop to act on a signal or web request */
+void cls_motapp::wake()
 {
+    evwait->wake();
+}
 
+cls_motapp::cls_motapp()
+{
+    evwait = new cls_evwait();
+    motevwait = evwait;
 }
 
 cls_motapp::~cls_motapp()
 {
-
+    motevwait = nullptr;
+    mydelete(evwait);
 }
\ No newline at end of file
@@ -29,6 +29,7 @@
 #include <locale.h>
 #include <string.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <fcntl.h>
 #include <time.h>
 #include <signal.h>
@@ -47,6 +48,7 @@
 #include <string>
 #include <list>
 #include <vector>
+#include <deque>
 #include <iostream>
 #include <fstream>
 #include <regex.h>
@@ -92,6 +94,11 @@ class cls_motapp;
 class cls_camera;
 class cls_allcam;
 class cls_schedule;
+class cls_storage;
+class cls_evwait;
+class cls_profile;
+class cls_encbench;
+class cls_extshm;
 class cls_sound;
 class cls_algsec;
 class cls_alg;
@@ -104,6 +111,7 @@ class cls_netcam;
 class cls_picture;
 class cls_rotate;
 class cls_v4l2cam;
+class cls_v4l2poll;
 class cls_convert;
 class cls_libcam;
 class cls_webu;
@@ -116,6 +124,7 @@ class cls_webu_mpegts;
 class cls_webu_post;
 class cls_webu_common;
 class cls_webu_stream;
+struct ctx_coord;
 
 enum MOTION_SIGNAL {
     MOTION_SIGNAL_NONE,
@@ -191,6 +200,7 @@ class cls_motapp {
         int     argc;
         char    **argv;
         std::string user_pause;
+        bool        bench_encoders;
 
         cls_config          *conf_src;
         cls_config          *cfg;
@@ -198,6 +208,9 @@ class cls_motapp {
         cls_dbse            *dbse;
         cls_allcam          *allcam;
         cls_schedule        *schedule;
+        cls_evwait          *evwait;            /* Wakes the main loop */
+        cls_encbench        *encbench;          /* Encoders chosen by --bench-encoders */
+        cls_v4l2poll        *v4l2poll;          /* Capture reactor for the V4L2 devices */
 
         pthread_mutex_t     mutex_camlst;       /* Lock the list of cams while adding/removing */
         pthread_mutex_t     mutex_post;         /* mutex to allow for processing of post actions*/
@@ -209,6 +222,7 @@ class cls_motapp {
         void deinit();
         void camera_add();
         void camera_delete();
+        void wake();
 
     private:
         void pid_write();
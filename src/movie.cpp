@@ -24,7 +24,17 @@
 #include "netcam.hpp"
 #include "dbse.hpp"
 #include "alg_sec.hpp"
+#include "encbench.hpp"
+#include "storage.hpp"
+#include "evwait.hpp"
 #include "movie.hpp"
+#include "extshm.hpp"
+
+static void *movie_handler(void *arg)
+{
+    ((cls_movie *)arg)->handler();
+    return nullptr;
+}
 
 int movie_interrupt(void *ctx)
 {
@@ -87,20 +97,63 @@ int cls_movie::timelapse_exists(const char *fname)
 
 int cls_movie::timelapse_append(AVPacket *p_pkt)
 {
-    FILE *file;
+    if (tlapse_file == nullptr) {
+        tlapse_file = myfopen(full_nm.c_str(), "abe");
+        if (tlapse_file == nullptr) {
+            return -1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &tlapse_sync_ts);
+    }
 
-    file = myfopen(full_nm.c_str(), "abe");
-    if (file == nullptr) {
+    if (fwrite(p_pkt->data, 1, (uint)p_pkt->size, tlapse_file) != (uint)p_pkt->size) {
+        MOTION_LOG(ERR, TYPE_ENCODER, SHOW_ERRNO
+            , _("Error appending to %s"), full_nm.c_str());
         return -1;
     }
 
-    fwrite(p_pkt->data, 1, (uint)p_pkt->size, file);
-
-    myfclose(file);
+    timelapse_checkpoint(false);
 
     return 0;
 }
 
+/* Push the frames written so far to disk once each checkpoint interval */
+void cls_movie::timelapse_checkpoint(bool force)
+{
+    struct timespec ts;
+
+    if ((tlapse_sync == 0) && (force == false)) {
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if ((force == false) &&
+        ((ts.tv_sec - tlapse_sync_ts.tv_sec) < tlapse_sync)) {
+        return;
+    }
+    tlapse_sync_ts = ts;
+
+    if (tlapse_file != nullptr) {
+        if (fflush(tlapse_file) != 0) {
+            MOTION_LOG(ERR, TYPE_ENCODER, SHOW_ERRNO
+                , _("Error flushing %s"), full_nm.c_str());
+            return;
+        }
+        fdatasync(fileno(tlapse_file));
+    } else if ((oc != nullptr) && (oc->pb != nullptr)) {
+        avio_flush(oc->pb);
+    }
+}
+
+void cls_movie::timelapse_close()
+{
+    if (tlapse_file == nullptr) {
+        return;
+    }
+    timelapse_checkpoint(true);
+    myfclose(tlapse_file);
+    tlapse_file = nullptr;
+}
+
 void cls_movie::free_context()
 {
     if (picture != nullptr) {
@@ -157,6 +210,13 @@ int cls_movie::get_oformat()
         oc->video_codec_id = AV_CODEC_ID_H264;
     }
 
+    if (container == "fmp4") {
+        oc->oformat = av_guess_format("mp4", nullptr, nullptr);
+        full_nm += ".mp4";
+        file_nm += ".mp4";
+        oc->video_codec_id = AV_CODEC_ID_H264;
+    }
+
     if (container == "mkv") {
         oc->oformat = av_guess_format("matroska", nullptr, nullptr);
         full_nm += ".mkv";
@@ -302,13 +362,22 @@ int cls_movie::set_quality()
              */
             char crf[10];
             quality = (int)(( (100-quality) * 51)/100);
+            rate_crf = quality;
             snprintf(crf, 10, "%d", quality);
             if (ctx_codec->codec_id == AV_CODEC_ID_H264) {
                 av_opt_set(ctx_codec->priv_data, "profile", "high", 0);
             }
             av_opt_set(ctx_codec->priv_data, "crf", crf, 0);
             av_opt_set(ctx_codec->priv_data, "tune", "zerolatency", 0);
-            av_opt_set(ctx_codec->priv_data, "preset", cam->cfg->movie_encoder_preset.c_str(), 0);
+            /* The benchmarked preset only replaces the default preset */
+            if ((bench_preset != "") &&
+                (cam->cfg->movie_encoder_preset == "medium")) {
+                MOTION_LOG(INF, TYPE_ENCODER, NO_ERRNO
+                    ,_("Using benchmarked preset %s"), bench_preset.c_str());
+                av_opt_set(ctx_codec->priv_data, "preset", bench_preset.c_str(), 0);
+            } else {
+                av_opt_set(ctx_codec->priv_data, "preset", cam->cfg->movie_encoder_preset.c_str(), 0);
+            }
         }
     } else {
         /* The selection of 8000 is a subjective number based upon viewing output files */
@@ -326,7 +395,21 @@ int cls_movie::set_quality()
 
 int cls_movie::set_codec_preferred()
 {
+    std::string enc_nm, enc_preset;
+
     codec = nullptr;
+    bench_preset = "";
+    if ((preferred_codec == "") &&
+        (cam->app->encbench->get(oc->video_codec_id, enc_nm, enc_preset))) {
+        codec = avcodec_find_encoder_by_name(enc_nm.c_str());
+        if (codec != nullptr) {
+            preferred_codec = enc_nm;
+            bench_preset = enc_preset;
+            MOTION_LOG(NTC, TYPE_ENCODER, NO_ERRNO
+                ,_("Using benchmarked codec %s"), enc_nm.c_str());
+            return 0;
+        }
+    }
     if (preferred_codec != "") {
         codec = avcodec_find_encoder_by_name(preferred_codec.c_str());
         if (codec == nullptr) {
@@ -393,6 +476,7 @@ int cls_movie::set_codec()
     */
     if ((tlapse == TIMELAPSE_NONE) && (fps <= 5)) {
         if ((container == "mp4") ||
+            (container == "fmp4") ||
             (container == "hevc")) {
             MOTION_LOG(NTC, TYPE_ENCODER, NO_ERRNO
                 , "Low fps. Encoding %d frames into a %d frames container."
@@ -573,6 +657,7 @@ int cls_movie::set_outputfile()
 {
     int retcd;
     char errstr[128];
+    AVDictionary *mux_opts = nullptr;
 
     /* Open the output file, if needed. */
     if ((timelapse_exists(full_nm.c_str()) == 0) || (tlapse != TIMELAPSE_APPEND)) {
@@ -608,13 +693,23 @@ int cls_movie::set_outputfile()
             }
         }
 
+        /* Fragments are written at each key frame so the file is playable
+         * while recording and the muxer only holds one GOP.
+         */
+        if (container == "fmp4") {
+            av_dict_set(&mux_opts, "movflags"
+                , "frag_keyframe+empty_moov+default_base_moof", 0);
+        }
+
         clock_gettime(CLOCK_MONOTONIC, &cb_st_ts);
-        retcd = avformat_write_header(oc, nullptr);
+        retcd = avformat_write_header(oc, &mux_opts);
+        av_dict_free(&mux_opts);
         if (retcd < 0) {
             av_strerror(retcd, errstr, sizeof(errstr));
             MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO
                 ,_("Could not write movie header %s"),errstr);
-            if ((container == "mp4") && (strm_audio != nullptr)) {
+            if (((container == "mp4") || (container == "fmp4")) &&
+                (strm_audio != nullptr)) {
                 MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO
                     , _("Ensure audio codec is permitted with a MP4 container."));
             }
@@ -709,6 +804,9 @@ int cls_movie::put_frame(const struct timespec *ts1)
         retcd = timelapse_append(pkt);
     } else {
         retcd = av_write_frame(oc, pkt);
+        if ((retcd >= 0) && (tlapse == TIMELAPSE_NEW)) {
+            timelapse_checkpoint(false);
+        }
     }
     free_pkt();
 
@@ -720,17 +818,10 @@ int cls_movie::put_frame(const struct timespec *ts1)
 
 }
 
-/* Reset the written flag and movie start time at opening of each event */
+/* Reset the cursor of written packets at opening of each movie */
 void cls_movie::passthru_reset()
 {
-    int indx;
-
-    pthread_mutex_lock(&netcam_data->mutex_pktarray);
-        for(indx = 0; indx < netcam_data->pktarray_size; indx++) {
-            netcam_data->pktarray[indx].iswritten = false;
-        }
-    pthread_mutex_unlock(&netcam_data->mutex_pktarray);
-
+    pass_cursor = 0;
 }
 
 int cls_movie::passthru_pktpts()
@@ -798,22 +889,14 @@ int cls_movie::passthru_pktpts()
     return 0;
 }
 
-void cls_movie::passthru_write(int indx)
+void cls_movie::passthru_write(AVPacket *p_pkt)
 {
-    /* Write the packet in the buffer at indx to file */
+    /* Write our reference to the packet to file and release it */
     char errstr[128];
     int retcd;
 
-    pkt = mypacket_alloc(pkt);
-    netcam_data->pktarray[indx].iswritten = true;
-
-    retcd = av_packet_ref(pkt, netcam_data->pktarray[indx].packet);
-    if (retcd < 0) {
-        av_strerror(retcd, errstr, sizeof(errstr));
-        MOTION_LOG(INF, TYPE_ENCODER, NO_ERRNO, "av_packet_ref: %s",errstr);
-        free_pkt();
-        return;
-    }
+    free_pkt();
+    pkt = p_pkt;
 
     retcd = passthru_pktpts();
     if (retcd < 0) {
@@ -889,8 +972,23 @@ void cls_movie::passthru_minpts()
 
 int cls_movie::passthru_put(ctx_image_data *img_data)
 {
-    int64_t idnbr_image, idnbr_lastwritten, idnbr_stop, idnbr_firstkey;
-    int indx, indx_lastwritten, indx_firstkey, indx_video;
+    if (high_resolution) {
+        return passthru_upto(img_data->idnbr_high);
+    } else {
+        return passthru_upto(img_data->idnbr_norm);
+    }
+}
+
+/* Write the packets after the cursor up to the packet id of the image.
+ * The ring is only locked while taking references to the packets so
+ * the netcam thread is not held up by the writing of the file.
+ */
+int cls_movie::passthru_upto(int64_t idnbr_image)
+{
+    int64_t idnbr_start, idnbr_key, idnbr_oldest, id;
+    int indx;
+    AVPacket *p_pkt;
+    std::vector<AVPacket*> pkts;
 
     if (netcam_data == nullptr) {
         return -1;
@@ -901,69 +999,62 @@ int cls_movie::passthru_put(ctx_image_data *img_data)
         return 0;
     }
 
-    if (high_resolution) {
-        idnbr_image = img_data->idnbr_high;
-    } else {
-        idnbr_image = img_data->idnbr_norm;
+    if (idnbr_image <= pass_cursor) {
+        return 0;
     }
 
     pthread_mutex_lock(&netcam_data->mutex_pktarray);
-        idnbr_lastwritten = 0;
-        idnbr_firstkey = idnbr_image;
-        idnbr_stop = 0;
-        indx_lastwritten = -1;
-        indx_firstkey = -1;
-        indx_video = netcam_data->video_stream_index;
-
-        for(indx = 0; indx < netcam_data->pktarray_size; indx++) {
-            if ((netcam_data->pktarray[indx].iswritten) &&
-                (netcam_data->pktarray[indx].idnbr > idnbr_lastwritten) &&
-                (netcam_data->pktarray[indx].packet->stream_index == indx_video)) {
-                idnbr_lastwritten=netcam_data->pktarray[indx].idnbr;
-                indx_lastwritten = indx;
-            }
-            if ((netcam_data->pktarray[indx].idnbr >  idnbr_stop) &&
-                (netcam_data->pktarray[indx].idnbr <= idnbr_image)&&
-                (netcam_data->pktarray[indx].packet->stream_index == indx_video)) {
-                idnbr_stop=netcam_data->pktarray[indx].idnbr;
+        idnbr_oldest = netcam_data->pktarray_oldest();
+        if ((pass_cursor != 0) && (pass_cursor >= (idnbr_oldest - 1))) {
+            idnbr_start = pass_cursor + 1;
+        } else {
+            if (pass_cursor != 0) {
+                MOTION_LOG(WRN, TYPE_ENCODER, NO_ERRNO
+                    ,_("Packets lost.  Movie writing fell behind the camera"));
             }
-            if ((netcam_data->pktarray[indx].iskey) &&
-                (netcam_data->pktarray[indx].idnbr <= idnbr_firstkey)&&
-                (netcam_data->pktarray[indx].packet->stream_index == indx_video)) {
-                    idnbr_firstkey=netcam_data->pktarray[indx].idnbr;
-                    indx_firstkey = indx;
+            /* Begin at the oldest key frame still held for the image */
+            idnbr_start = idnbr_oldest;
+            indx = netcam_data->pktarray_slot(idnbr_image);
+            if (indx != -1) {
+                idnbr_key = netcam_data->pktarray[indx].keynbr;
+                while ((idnbr_key != 0) &&
+                    (netcam_data->pktarray_slot(idnbr_key) != -1)) {
+                    idnbr_start = idnbr_key;
+                    indx = netcam_data->pktarray_slot(idnbr_key - 1);
+                    if (indx == -1) {
+                        break;
+                    }
+                    idnbr_key = netcam_data->pktarray[indx].keynbr;
+                }
             }
         }
 
-        if (idnbr_stop == 0) {
-            pthread_mutex_unlock(&netcam_data->mutex_pktarray);
-            return 0;
-        }
-
-        if (indx_lastwritten != -1) {
-            indx = indx_lastwritten;
-        } else if (indx_firstkey != -1) {
-            indx = indx_firstkey;
-        } else {
-            indx = 0;
+        if (segment_pend && (idnbr_start <= idnbr_image)) {
+            segment_lag = segment_span(idnbr_start, idnbr_image);
         }
 
-        while (true){
-            if ((!netcam_data->pktarray[indx].iswritten) &&
-                (netcam_data->pktarray[indx].packet->size > 0) &&
-                (netcam_data->pktarray[indx].idnbr >  idnbr_lastwritten) &&
-                (netcam_data->pktarray[indx].idnbr <= idnbr_image)) {
-                passthru_write(indx);
-            }
-            if (netcam_data->pktarray[indx].idnbr == idnbr_stop) {
-                break;
+        for (id = idnbr_start; id <= idnbr_image; id++) {
+            indx = netcam_data->pktarray_slot(id);
+            if ((indx == -1) ||
+                (netcam_data->pktarray[indx].packet->size <= 0)) {
+                continue;
             }
-            indx++;
-            if (indx == netcam_data->pktarray_size ) {
-                indx = 0;
+            p_pkt = mypacket_alloc(nullptr);
+            if (av_packet_ref(p_pkt, netcam_data->pktarray[indx].packet) < 0) {
+                av_packet_free(&p_pkt);
+                continue;
             }
+            pkts.push_back(p_pkt);
+        }
+        if (idnbr_start <= idnbr_image) {
+            pass_cursor = idnbr_image;
         }
     pthread_mutex_unlock(&netcam_data->mutex_pktarray);
+
+    for (indx = 0; indx < (int)pkts.size(); indx++) {
+        passthru_write(pkts[(uint)indx]);
+    }
+
     return 0;
 }
 
@@ -1094,6 +1185,7 @@ int cls_movie::passthru_open()
     cb_dur = 3;
 
     if ((container != "mp4") &&
+        (container != "fmp4") &&
         (container != "mov") &&
         (container != "mkv")) {
         MOTION_LOG(NTC, TYPE_ENCODER, NO_ERRNO
@@ -1135,16 +1227,8 @@ int cls_movie::passthru_open()
     return 0;
 }
 
-void cls_movie::put_pix_yuv420(ctx_image_data *img_data)
+void cls_movie::put_pix_yuv420(u_char *image)
 {
-    unsigned char *image;
-
-    if (high_resolution) {
-        image = img_data->image_high;
-    } else {
-        image = img_data->image_norm;
-    }
-
     // Usual setup for image pointers
     picture->data[0] = image;
     picture->data[1] = image + (ctx_codec->width * ctx_codec->height);
@@ -1226,14 +1310,23 @@ void cls_movie::stop()
         return;
     }
 
+    queue_drain();
+
     clock_gettime(CLOCK_MONOTONIC, &cb_st_ts);
 
     if (movie_type == "extpipe") {
         if (extpipe_stream != nullptr) {
             fflush(extpipe_stream);
-            pclose(extpipe_stream);
+            if (extshm->is_open()) {
+                extshm->cmd_close(extpipe_stream);
+            } else {
+                pclose(extpipe_stream);
+            }
             extpipe_stream = nullptr;
         }
+        extshm->close();
+    } else if (preroll_use()) {
+        preroll_stop();
     } else {
         if (flush_codec() < 0) {
             MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO, _("Error flushing codec"));
@@ -1252,6 +1345,7 @@ void cls_movie::stop()
         }
         free_context();
         free_nal();
+        timelapse_close();
     }
 
     if (movie_type == "motion") {
@@ -1261,19 +1355,25 @@ void cls_movie::stop()
     }
 
     if ((movie_type == "norm") || (movie_type == "motion") || (movie_type == "extpipe")) {
-        on_movie_end();
-        cam->app->dbse->exec(cam, full_nm, "movie_end");
+        if (segment_rolling == false) {
+            on_movie_end();
+            cam->app->dbse->exec(cam, full_nm, "movie_end");
+        }
+        /* Only the movies kept count towards the storage forecast */
         if ((cam->cfg->movie_retain == "secondary") &&
+            (segment_use() == false) &&
             (cam->algsec->detected == false) &&
             (cam->algsec->method != "none")) {
             if (remove(full_nm.c_str()) != 0) {
                 MOTION_LOG(ERR, TYPE_EVENTS, SHOW_ERRNO
                     , _("Unable to remove file %s"), full_nm.c_str());
+                cam->storage->file_saved(full_nm, true);
             } else {
                 cam->app->dbse->filelist_add(cam, ts, "movie"
                     , file_nm, full_nm, file_dir);
             }
         } else {
+            cam->storage->file_saved(full_nm, true);
             cam->app->dbse->filelist_add(cam, ts, "movie"
                     , file_nm, full_nm, file_dir);
         }
@@ -1288,56 +1388,64 @@ void cls_movie::stop()
 
 }
 
-int cls_movie::extpipe_put()
+int cls_movie::extpipe_put(u_char *image, const struct timespec *ts1)
 {
     int retcd;
 
+    if (extshm->is_open()) {
+        retcd = extshm->put(image, ts1);
+        if (retcd == 1) {
+            pthread_mutex_lock(&mutex_queue);
+                queue_dropped++;
+            pthread_mutex_unlock(&mutex_queue);
+            retcd = 0;
+        }
+        return retcd;
+    }
+
     retcd = 0;
     if (fileno(extpipe_stream) > 0) {
-        if ((cam->imgs.size_high > 0) && (cam->movie_passthrough == false)) {
-            if (!fwrite(cam->current_image->image_high
-                    , (uint)cam->imgs.size_high, 1, extpipe_stream)) {
-                MOTION_LOG(ERR, TYPE_EVENTS, SHOW_ERRNO
-                    , _("Error writing in pipe , state error %d")
-                    , ferror(extpipe_stream));
-                retcd = -1;
-            }
-        } else {
-            if (!fwrite(cam->current_image->image_norm
-                    , (uint)cam->imgs.size_norm, 1, extpipe_stream)) {
-                MOTION_LOG(ERR, TYPE_EVENTS, SHOW_ERRNO
-                  ,_("Error writing in pipe , state error %d")
-                  , ferror(extpipe_stream));
-                retcd = -1;
-            }
+        if (!fwrite(image, queue_sz, 1, extpipe_stream)) {
+            MOTION_LOG(ERR, TYPE_EVENTS, SHOW_ERRNO
+                , _("Error writing in pipe , state error %d")
+                , ferror(extpipe_stream));
+            retcd = -1;
         }
     }
     return retcd;
 }
 
-int cls_movie::put_image(ctx_image_data *img_data, const struct timespec *ts1)
+/* The image of the ring item that is written to the movie */
+u_char *cls_movie::image_src(ctx_image_data *img_data)
+{
+    if (movie_type == "extpipe") {
+        if ((cam->imgs.size_high > 0) && (cam->movie_passthrough == false)) {
+            return img_data->image_high;
+        }
+        return img_data->image_norm;
+    }
+    if (high_resolution) {
+        return img_data->image_high;
+    }
+    return img_data->image_norm;
+}
+
+int cls_movie::encode_image(u_char *image, const struct timespec *ts1)
 {
     int retcd = 0;
     int cnt = 0;
 
-    if (is_running == false) {
-        return 0;
+    if (preroll_use()) {
+        return preroll_encode(image, ts1);
     }
 
-    clock_gettime(CLOCK_MONOTONIC, &cb_st_ts);
-
     if (movie_type == "extpipe") {
-        extpipe_put();
+        extpipe_put(image, ts1);
         return 0;
     }
 
-    if (passthrough) {
-        retcd = passthru_put(img_data);
-        return retcd;
-    }
-
     if (picture) {
-        put_pix_yuv420(img_data);
+        put_pix_yuv420(image);
 
         gop_cnt ++;
         if (gop_cnt == ctx_codec->gop_size ) {
@@ -1349,6 +1457,10 @@ int cls_movie::put_image(ctx_image_data *img_data, const struct timespec *ts1)
              myframe_interlaced(picture);
         }
 
+        rate_apply();
+        myframe_roi(picture, roi_enc, cam->imgs.width, cam->imgs.height
+            , cam->cfg->movie_roi);
+
         /* A return code of -2 is thrown by the put_frame
          * when a image is buffered.  For timelapse, we absolutely
          * never want a frame buffered so we keep sending back the
@@ -1374,129 +1486,1126 @@ int cls_movie::put_image(ctx_image_data *img_data, const struct timespec *ts1)
     return retcd;
 }
 
-void cls_movie::reset_start_time(const struct timespec *ts1)
+bool cls_movie::rate_use()
 {
-    int64_t one_frame_interval = av_rescale_q(1,av_make_q(1, fps), strm_video->time_base);
-    if (one_frame_interval <= 0) {
-        one_frame_interval = 1;
-    }
-    base_pts = last_pts + one_frame_interval;
-
-    start_time.tv_sec = ts1->tv_sec;
-    start_time.tv_nsec = ts1->tv_nsec;
+    return (((rate_adaptive == true) || (rate_quiet_fps > 0)) &&
+        ((movie_type == "norm") || (movie_type == "motion")) &&
+        (passthrough == false));
+}
 
+/* Each movie starts as though at the motion threshold */
+void cls_movie::rate_reset()
+{
+    rate_level = 1.0;
+    rate_ofs = 0;
+    rate_enc = 0;
+    rate_cur = 0;
+    rate_ok = -1;
+    rate_ts.tv_sec = 0;
+    rate_ts.tv_nsec = 0;
 }
 
-void cls_movie::init_container()
+/* Follow the motion of the camera images and choose the quality offset.
+ * The offset is the full range above the movie_quality when nothing
+ * moves, zero at the threshold and the full range below at twice the
+ * threshold.  Returns false for images skipped during quiet periods.
+ */
+bool cls_movie::rate_keep(ctx_image_data *img_data)
 {
-    int codenbr;
-    size_t col_pos;
+    double level;
+    int64_t usec;
 
-    if (cam->cfg->movie_container == "test") {
-        MOTION_LOG(NTC, TYPE_ENCODER, NO_ERRNO, "Running test of the various output formats.");
-        codenbr = cam->event_curr_nbr % 6;
-        if (codenbr == 1) {
-            container = "mov";
-        } else if (codenbr == 2) {
-            container = "webm";
-        } else if (codenbr == 3) {
-            container = "mp4";
-        } else if (codenbr == 4) {
-            container = "mkv";
-        } else if (codenbr == 5) {
-            container = "hevc";
-        } else {
-            container = "mp4";
-        }
-    } else {
-        container = cam->cfg->movie_container;
+    if (rate_use() == false) {
+        return true;
     }
 
-    col_pos = container.find(":");
-    if (col_pos == std::string::npos) {
-        preferred_codec = "";
+    if (cam->threshold > 0) {
+        level = MIN((double)img_data->diffs / cam->threshold, 2.0);
     } else {
-        preferred_codec = container.substr(col_pos+1);
-        container = container.substr(0,col_pos);
+        level = 0;
+    }
+    rate_level = (rate_level * 0.75) + (level * 0.25);
+
+    if (rate_adaptive) {
+        rate_ofs = (int)lround(rate_range * (1.0 - rate_level));
+    }
+
+    if ((rate_quiet_fps > 0) && (rate_level < 0.1)) {
+        usec = ((img_data->monots.tv_sec - rate_ts.tv_sec) * 1000000L) +
+            ((img_data->monots.tv_nsec - rate_ts.tv_nsec) / 1000);
+        if (usec < (1000000L / rate_quiet_fps)) {
+            return false;
+        }
     }
+    rate_ts = img_data->monots;
 
+    return true;
 }
 
-void cls_movie::start_norm()
+/* Set the quality offset of the image on the encoder */
+void cls_movie::rate_apply()
 {
-    char tmp[PATH_MAX];
+    int qscale;
 
-    if (cam->cfg->movie_output == false) {
-        is_running = false;
+    if ((rate_adaptive == false) || (rate_use() == false)) {
         return;
     }
 
-    init_container();
-
-    mystrftime(cam, tmp, sizeof(tmp), cam->cfg->movie_filename.c_str(), nullptr);
+    /* Only libx264 reconfigures when the crf changes and only the
+     * qscale encoders take a quality per image.
+     */
+    if (rate_ok == -1) {
+        if (mystreq(codec->name, "libx264") ||
+            ((ctx_codec->codec_id != AV_CODEC_ID_H264) &&
+             (ctx_codec->codec_id != AV_CODEC_ID_HEVC) &&
+             (ctx_codec->flags & AV_CODEC_FLAG_QSCALE))) {
+            rate_ok = 1;
+        } else {
+            rate_ok = 0;
+            MOTION_LOG(NTC, TYPE_ENCODER, NO_ERRNO
+                ,_("Encoder %s can not adapt the quality.  Using a fixed quality")
+                , codec->name);
+        }
+    }
+    if (rate_ok == 0) {
+        return;
+    }
 
-    file_nm = tmp;
-    if (container =="test") {
-        full_nm = cam->cfg->target_dir + "/"  + container + "_" + file_nm;
+    if (mystreq(codec->name, "libx264")) {
+        if (rate_enc != rate_cur) {
+            if (av_opt_set_double(ctx_codec->priv_data, "crf"
+                    , MAX(0, MIN(51, rate_crf + rate_enc)), 0) < 0) {
+                MOTION_LOG(NTC, TYPE_ENCODER, NO_ERRNO
+                    ,_("Unable to change the crf.  Using a fixed quality"));
+                rate_ok = 0;
+                return;
+            }
+            rate_cur = rate_enc;
+        }
     } else {
-        full_nm = cam->cfg->target_dir + "/"  + file_nm;
+        qscale = ctx_codec->global_quality + (rate_enc * FF_QP2LAMBDA);
+        picture->quality = MAX(FF_QP2LAMBDA, qscale);
+        rate_cur = rate_enc;
     }
-    file_dir =full_nm.substr(0,full_nm.find_last_of("/"));
-    file_nm = full_nm.substr(file_dir.length()+1);
+}
 
-    if (cam->imgs.size_high > 0) {
-        width  = cam->imgs.width_high;
-        height = cam->imgs.height_high;
-        high_resolution = true;
-        netcam_data = cam->netcam_high;
-    } else {
-        width  = cam->imgs.width;
-        height = cam->imgs.height;
-        high_resolution = false;
-        netcam_data = cam->netcam;
+int cls_movie::put_image(ctx_image_data *img_data, const struct timespec *ts1)
+{
+    if ((is_running == false) || (preroll_use() == true) ||
+        (segment_use() == true)) {
+        return 0;
     }
-    pkt = nullptr;
-    tlapse = TIMELAPSE_NONE;
-    fps = cam->lastrate;
-    start_time.tv_sec = cam->current_image->imgts.tv_sec;
-    start_time.tv_nsec = cam->current_image->imgts.tv_nsec;
-    last_pts = -1;
-    base_pts = 0;
-    gop_cnt = 0;
 
-    if (cam->cfg->movie_container == "test") {
-        test_mode = true;
-    } else {
-        test_mode = false;
+    if (passthrough) {
+        clock_gettime(CLOCK_MONOTONIC, &cb_st_ts);
+        return passthru_put(img_data);
     }
-    motion_images = false;
-    passthrough = cam->movie_passthrough;
 
-    if (movie_open() < 0) {
-        MOTION_LOG(ERR, TYPE_EVENTS, NO_ERRNO
-            ,_("Error initializing movie."));
-        return;
+    if (rate_keep(img_data) == false) {
+        return 0;
     }
 
-    on_movie_start();
+    if (cam->cfg->movie_roi > 0) {
+        cam->roi_get(img_data, roi_next);
+    }
 
-    cam->app->dbse->exec(cam, full_nm, "movie_start");
+    if (queue_use()) {
+        return queue_put(image_src(img_data), ts1, false);
+    }
 
-    is_running = true;
+    clock_gettime(CLOCK_MONOTONIC, &cb_st_ts);
 
+    rate_enc = rate_ofs;
+    roi_enc.swap(roi_next);
+
+    return encode_image(image_src(img_data), ts1);
 }
 
-void cls_movie::start_motion()
+void cls_movie::reset_pts(const struct timespec *ts1)
 {
-    char tmp[PATH_MAX];
-    ctx_image_data save_data;
+    int64_t one_frame_interval = av_rescale_q(1,av_make_q(1, fps), strm_video->time_base);
+    if (one_frame_interval <= 0) {
+        one_frame_interval = 1;
+    }
+    base_pts = last_pts + one_frame_interval;
 
-    if (cam->cfg->movie_output_motion == false) {
-        is_running = false;
+    start_time.tv_sec = ts1->tv_sec;
+    start_time.tv_nsec = ts1->tv_nsec;
+
+}
+
+/* Images already queued keep their timing so the reset is queued behind them */
+void cls_movie::reset_start_time(const struct timespec *ts1)
+{
+    if (preroll_use() || segment_use()) {
         return;
     }
+    if (queue_use()) {
+        queue_put(nullptr, ts1, true);
+    } else {
+        reset_pts(ts1);
+    }
+}
 
-    init_container();
+bool cls_movie::preroll_use()
+{
+    return ((preroll_sec > 0) && (movie_type == "norm") &&
+        (cam->movie_passthrough == false) &&
+        (cam->cfg->movie_output == true));
+}
+
+/* Open the encoder that runs continuously to fill the pre-roll */
+int cls_movie::preroll_open(const struct timespec *ts1)
+{
+    std::string sv_full, sv_file;
+
+    sv_full = full_nm;
+    sv_file = file_nm;
+
+    init_container();
+    tlapse = TIMELAPSE_NONE;
+    fps = cam->cfg->framerate;
+    last_pts = -1;
+    test_mode = false;
+    motion_images = false;
+
+    oc = avformat_alloc_context();
+    if (oc == nullptr) {
+        MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO, _("Could not allocate output context"));
+        return -1;
+    }
+    if ((get_oformat() < 0) || (set_codec() < 0) || (set_picture() < 0)) {
+        MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO, _("Could not open pre-roll encoder"));
+        full_nm = sv_full;
+        file_nm = sv_file;
+        return -1;
+    }
+    /* The container is created again for each movie */
+    avformat_free_context(oc);
+    oc = nullptr;
+    strm_video = nullptr;
+
+    full_nm = sv_full;
+    file_nm = sv_file;
+    preroll_ts = *ts1;
+
+    MOTION_LOG(INF, TYPE_ENCODER, NO_ERRNO
+        , _("Pre-roll encoder opened for %d seconds"), preroll_sec);
+
+    return 0;
+}
+
+void cls_movie::preroll_close()
+{
+    while (preroll_pkts.empty() == false) {
+        av_packet_free(&preroll_pkts.front());
+        preroll_pkts.pop_front();
+    }
+    preroll_bytes = 0;
+    preroll_file = false;
+    free_context();
+    free_pkt();
+    free_nal();
+}
+
+/* Write a copy of a pre-roll packet with the pts based on the file start */
+void cls_movie::preroll_write(AVPacket *p_pkt)
+{
+    AVPacket *wpkt;
+
+    wpkt = av_packet_clone(p_pkt);
+    if (wpkt == nullptr) {
+        return;
+    }
+    wpkt->pts -= preroll_base;
+    wpkt->dts -= preroll_base;
+    wpkt->stream_index = strm_video->index;
+    av_packet_rescale_ts(wpkt, ctx_codec->time_base, strm_video->time_base);
+    if (av_write_frame(oc, wpkt) < 0) {
+        MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO, _("Error while writing video frame"));
+    }
+    av_packet_free(&wpkt);
+}
+
+/* Discard whole GOPs while the rest still covers the pre-roll time */
+void cls_movie::preroll_trim()
+{
+    int64_t limit, newest;
+    size_t indx, keyindx;
+
+    limit = av_rescale_q(preroll_sec, av_make_q(1, 1), ctx_codec->time_base);
+    newest = preroll_pkts.back()->pts;
+
+    while (preroll_pkts.size() > 1) {
+        keyindx = 0;
+        for (indx=1; indx<preroll_pkts.size(); indx++) {
+            if (preroll_pkts[indx]->flags & AV_PKT_FLAG_KEY) {
+                keyindx = indx;
+                break;
+            }
+        }
+        if ((keyindx == 0) || ((newest - preroll_pkts[keyindx]->pts) < limit)) {
+            break;
+        }
+        for (indx=0; indx<keyindx; indx++) {
+            preroll_bytes -= preroll_pkts.front()->size;
+            av_packet_free(&preroll_pkts.front());
+            preroll_pkts.pop_front();
+        }
+    }
+}
+
+/* Encode every camera image into the packet ring and the open file */
+int cls_movie::preroll_encode(u_char *image, const struct timespec *ts1)
+{
+    int retcd;
+    int64_t usec;
+    char errstr[128];
+
+    if (ctx_codec == nullptr) {
+        if (preroll_open(ts1) < 0) {
+            return -1;
+        }
+    }
+
+    usec = ((int64_t)(ts1->tv_sec - preroll_ts.tv_sec) * 1000000L) +
+        ((ts1->tv_nsec - preroll_ts.tv_nsec) / 1000);
+    picture->pts = av_rescale_q(usec, av_make_q(1, 1000000L), ctx_codec->time_base);
+    if (picture->pts <= last_pts) {
+        return 0;
+    }
+    last_pts = picture->pts;
+
+    put_pix_yuv420(image);
+    gop_cnt++;
+    if (gop_cnt >= ctx_codec->gop_size) {
+        picture->pict_type = AV_PICTURE_TYPE_I;
+        myframe_key(picture);
+        gop_cnt = 0;
+    } else {
+        picture->pict_type = AV_PICTURE_TYPE_P;
+        myframe_interlaced(picture);
+    }
+
+    rate_apply();
+    myframe_roi(picture, roi_enc, cam->imgs.width, cam->imgs.height
+        , cam->cfg->movie_roi);
+
+    retcd = avcodec_send_frame(ctx_codec, picture);
+    if (retcd < 0) {
+        av_strerror(retcd, errstr, sizeof(errstr));
+        MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO
+            ,_("Error sending frame for encoding:%s"),errstr);
+        return -1;
+    }
+
+    while (true) {
+        pkt = mypacket_alloc(pkt);
+        retcd = avcodec_receive_packet(ctx_codec, pkt);
+        if ((retcd == AVERROR(EAGAIN)) || (retcd == AVERROR_EOF)) {
+            free_pkt();
+            break;
+        }
+        if (retcd < 0) {
+            av_strerror(retcd, errstr, sizeof(errstr));
+            MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO
+                ,_("Error receiving encoded packet video:%s"),errstr);
+            free_pkt();
+            return -1;
+        }
+        if (preferred_codec == "h264_v4l2m2m") {
+            encode_nal();
+        }
+        if (preroll_file == true) {
+            preroll_write(pkt);
+        }
+        preroll_bytes += pkt->size;
+        preroll_pkts.push_back(pkt);
+        pkt = nullptr;
+        preroll_trim();
+    }
+
+    return 0;
+}
+
+/* Feed each camera image to the pre-roll encoder */
+void cls_movie::preroll_put(ctx_image_data *img_data)
+{
+    if (preroll_use() == false) {
+        return;
+    }
+
+    if (queue_sz == 0) {
+        if (cam->imgs.size_high > 0) {
+            width  = cam->imgs.width_high;
+            height = cam->imgs.height_high;
+            high_resolution = true;
+        } else {
+            width  = cam->imgs.width;
+            height = cam->imgs.height;
+            high_resolution = false;
+        }
+        queue_alloc();
+    }
+
+    if (rate_keep(img_data) == false) {
+        return;
+    }
+
+    if (cam->cfg->movie_roi > 0) {
+        cam->roi_get(img_data, roi_next);
+    }
+
+    if (queue_use()) {
+        queue_put(image_src(img_data), &img_data->imgts, false);
+    } else {
+        rate_enc = rate_ofs;
+        roi_enc.swap(roi_next);
+        encode_image(image_src(img_data), &img_data->imgts);
+    }
+}
+
+/* Open the file and write the ring from its oldest key frame */
+int cls_movie::preroll_start()
+{
+    int retcd;
+    size_t indx, keyindx;
+    char errstr[128];
+
+    queue_drain();
+
+    if (ctx_codec == nullptr) {
+        MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO, _("Pre-roll encoder is not open"));
+        return -1;
+    }
+
+    oc = avformat_alloc_context();
+    if (oc == nullptr) {
+        MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO, _("Could not allocate output context"));
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &cb_st_ts);
+    cb_dur = 3;
+    oc->interrupt_callback.callback = movie_interrupt;
+    oc->interrupt_callback.opaque = this;
+
+    /* A failure frees the encoder so the ring has to be started again */
+    if (get_oformat() < 0) {
+        preroll_close();
+        return -1;
+    }
+    strm_video = avformat_new_stream(oc, nullptr);
+    if (strm_video == nullptr) {
+        MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO, _("Could not alloc stream"));
+        preroll_close();
+        return -1;
+    }
+    retcd = avcodec_parameters_from_context(strm_video->codecpar, ctx_codec);
+    if (retcd < 0) {
+        av_strerror(retcd, errstr, sizeof(errstr));
+        MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO
+            ,_("Failed to copy decoder parameters!: %s"), errstr);
+        preroll_close();
+        return -1;
+    }
+    strm_video->time_base = ctx_codec->time_base;
+    if (set_outputfile() < 0) {
+        preroll_close();
+        return -1;
+    }
+
+    keyindx = preroll_pkts.size();
+    for (indx=0; indx<preroll_pkts.size(); indx++) {
+        if (preroll_pkts[indx]->flags & AV_PKT_FLAG_KEY) {
+            keyindx = indx;
+            break;
+        }
+    }
+    if (keyindx < preroll_pkts.size()) {
+        preroll_base = preroll_pkts[keyindx]->pts;
+        for (indx=keyindx; indx<preroll_pkts.size(); indx++) {
+            preroll_write(preroll_pkts[indx]);
+        }
+    } else {
+        preroll_base = last_pts + 1;
+        gop_cnt = ctx_codec->gop_size;  /* Begin the file with a key frame */
+    }
+    preroll_file = true;
+
+    return 0;
+}
+
+/* Close the file while the encoder keeps filling the ring */
+void cls_movie::preroll_stop()
+{
+    preroll_file = false;
+    if (oc != nullptr) {
+        if (oc->pb != nullptr) {
+            av_write_trailer(oc);
+            if (!(oc->oformat->flags & AVFMT_NOFILE)) {
+                avio_close(oc->pb);
+            }
+        }
+        avformat_free_context(oc);
+        oc = nullptr;
+    }
+    strm_video = nullptr;
+}
+
+bool cls_movie::segment_use()
+{
+    return ((segment_sec > 0) && (movie_type == "norm") &&
+        (cam->movie_passthrough == true) &&
+        (cam->cfg->movie_output == true));
+}
+
+/* Newest key frame not yet written that the image includes */
+int64_t cls_movie::segment_key(ctx_image_data *img_data)
+{
+    int64_t idnbr_image, idnbr_key;
+    int indx;
+
+    if (high_resolution) {
+        idnbr_image = img_data->idnbr_high;
+    } else {
+        idnbr_image = img_data->idnbr_norm;
+    }
+
+    idnbr_key = 0;
+    pthread_mutex_lock(&netcam_data->mutex_pktarray);
+        indx = netcam_data->pktarray_slot(idnbr_image);
+        if (indx != -1) {
+            idnbr_key = netcam_data->pktarray[indx].keynbr;
+        }
+    pthread_mutex_unlock(&netcam_data->mutex_pktarray);
+
+    if (idnbr_key <= pass_cursor) {
+        return 0;
+    }
+    return idnbr_key;
+}
+
+/* Nanoseconds between the key packet and the video packet of the image.
+ * The caller holds mutex_pktarray.
+ */
+int64_t cls_movie::segment_span(int64_t key_id, int64_t img_id)
+{
+    int indx_key, indx_img, indx_video;
+    AVPacket *pkt_key, *pkt_img;
+
+    indx_video = netcam_data->video_stream_index;
+    indx_key = netcam_data->pktarray_slot(key_id);
+    if (indx_key == -1) {
+        return 0;
+    }
+    pkt_key = netcam_data->pktarray[indx_key].packet;
+    if ((pkt_key->stream_index != indx_video) ||
+        (pkt_key->pts == AV_NOPTS_VALUE)) {
+        return 0;
+    }
+
+    pkt_img = nullptr;
+    while (img_id > key_id) {
+        indx_img = netcam_data->pktarray_slot(img_id);
+        if ((indx_img != -1) &&
+            (netcam_data->pktarray[indx_img].packet->stream_index == indx_video) &&
+            (netcam_data->pktarray[indx_img].packet->pts != AV_NOPTS_VALUE)) {
+            pkt_img = netcam_data->pktarray[indx_img].packet;
+            break;
+        }
+        img_id--;
+    }
+    if ((pkt_img == nullptr) || (pkt_img->pts <= pkt_key->pts)) {
+        return 0;
+    }
+
+    return av_rescale_q(pkt_img->pts - pkt_key->pts
+        , netcam_data->transfer_format->streams[indx_video]->time_base
+        , av_make_q(1, 1000000000L));
+}
+
+/* The segment begins at the first key packet written to the file */
+void cls_movie::segment_begin(ctx_image_data *img_data)
+{
+    int64_t nsec;
+
+    if (segment_lag < 0) {
+        return;
+    }
+    nsec = (img_data->imgts.tv_sec * 1000000000L) +
+        img_data->imgts.tv_nsec - segment_lag;
+    segment_ts.tv_sec = (time_t)(nsec / 1000000000L);
+    segment_ts.tv_nsec = (long)(nsec % 1000000000L);
+    segment_pend = false;
+    segment_lag = -1;
+}
+
+/* Close the segment and open the next without the movie start/end hooks */
+void cls_movie::segment_roll()
+{
+    segment_rolling = true;
+    stop();
+    start();
+    segment_rolling = false;
+}
+
+/* Begin the new segment at key_id so that no packets are written twice */
+void cls_movie::segment_seek(int64_t key_id)
+{
+    int indx, indx_audio, indx_video;
+    int64_t id, idnbr_newest;
+    AVPacket *p_pkt;
+
+    pass_audio_base = -1;
+    pass_video_base = -1;
+    pass_cursor = key_id - 1;
+
+    pthread_mutex_lock(&netcam_data->mutex_pktarray);
+        indx_audio = netcam_data->audio_stream_index;
+        indx_video = netcam_data->video_stream_index;
+        idnbr_newest = netcam_data->pktarray[netcam_data->pktarray_index].idnbr;
+        for (id = key_id; id <= idnbr_newest; id++) {
+            indx = netcam_data->pktarray_slot(id);
+            if (indx == -1) {
+                continue;
+            }
+            p_pkt = netcam_data->pktarray[indx].packet;
+            if ((p_pkt->stream_index == indx_video) && (id == key_id)) {
+                if (p_pkt->dts != AV_NOPTS_VALUE) {
+                    pass_video_base = p_pkt->dts;
+                } else {
+                    pass_video_base = p_pkt->pts;
+                }
+            }
+            if ((p_pkt->stream_index == indx_audio) &&
+                (p_pkt->pts != AV_NOPTS_VALUE) &&
+                ((pass_audio_base == -1) || (p_pkt->pts < pass_audio_base))) {
+                pass_audio_base = p_pkt->pts;
+            }
+        }
+    pthread_mutex_unlock(&netcam_data->mutex_pktarray);
+
+    if (pass_audio_base < 0) {
+        pass_audio_base = 0;
+    }
+    if (pass_video_base < 0) {
+        pass_video_base = 0;
+    }
+}
+
+/* Record the part of the event within the current segment */
+void cls_movie::segment_event(const struct timespec *ts_end)
+{
+    int evt_off, evt_len;
+
+    evt_off = (int)(evt_ts.tv_sec - segment_ts.tv_sec);
+    evt_len = (int)(ts_end->tv_sec - evt_ts.tv_sec);
+    if (evt_off < 0) {
+        evt_off = 0;
+    }
+    if (evt_len < 1) {
+        evt_len = 1;
+    }
+    cam->app->dbse->eventlist_add(cam, &evt_ts
+        , file_nm, full_nm, file_dir, evt_off, evt_len);
+}
+
+/* Write every image to the continuous segments */
+void cls_movie::segment_put(ctx_image_data *img_data)
+{
+    int64_t key_id;
+
+    if (segment_use() == false) {
+        return;
+    }
+
+    if (is_running == false) {
+        if ((img_data->imgts.tv_sec - segment_retry) < 10) {
+            return;
+        }
+        segment_retry = img_data->imgts.tv_sec;
+        start();
+        return;
+    }
+
+    if ((img_data->imgts.tv_sec - segment_ts.tv_sec) >= segment_sec) {
+        key_id = segment_key(img_data);
+        if (key_id > 0) {
+            passthru_upto(key_id - 1);
+            if (evt_active) {
+                segment_event(&img_data->imgts);
+                evt_ts = img_data->imgts;
+            }
+            segment_roll();
+            if (is_running == false) {
+                segment_retry = img_data->imgts.tv_sec;
+                return;
+            }
+            segment_seek(key_id);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &cb_st_ts);
+    passthru_put(img_data);
+    if (segment_pend) {
+        segment_begin(img_data);
+    }
+}
+
+/* With continuous segments an event only marks a range of the segment */
+void cls_movie::event_start()
+{
+    if (segment_use() == false) {
+        start();
+        return;
+    }
+    if (is_running == false) {
+        start();
+    }
+    evt_active = true;
+    evt_ts = cam->current_image->imgts;
+}
+
+void cls_movie::event_end()
+{
+    if (segment_use() == false) {
+        stop();
+        return;
+    }
+    if ((evt_active == true) && (is_running == true)) {
+        segment_event(&cam->current_image->imgts);
+    }
+    evt_active = false;
+}
+
+bool cls_movie::queue_use()
+{
+    /* The shared memory ring already decouples the extpipe command */
+    if (extshm->is_open()) {
+        return false;
+    }
+    return ((queue_max > 0) && (passthrough == false) &&
+        (handler_running == true));
+}
+
+/*
+ * Size the image buffers of the queue for the movie being started.  The
+ * encoder thread is only started once a movie actually uses the queue.
+ */
+void cls_movie::queue_alloc()
+{
+    size_t sz;
+    int indx;
+
+    if (movie_type == "extpipe") {
+        if ((cam->imgs.size_high > 0) && (cam->movie_passthrough == false)) {
+            sz = (size_t)cam->imgs.size_high;
+        } else {
+            sz = (size_t)cam->imgs.size_norm;
+        }
+    } else {
+        sz = (size_t)((width * height * 3) / 2);
+    }
+
+    if ((queue_max == 0) || (passthrough == true) || extshm->is_open()) {
+        queue_sz = sz;
+        return;
+    }
+
+    if (sz != queue_sz) {
+        queue_free();
+        for (indx=0; indx<queue_max; indx++) {
+            queue[(uint)indx].image = (u_char*)mymalloc(sz);
+        }
+    }
+    queue_sz = sz;
+
+    handler_startup();
+}
+
+void cls_movie::queue_free()
+{
+    int indx;
+
+    for (indx=0; indx<(int)queue.size(); indx++) {
+        myfree(queue[(uint)indx].image);
+    }
+    queue_sz = 0;
+}
+
+/* Copy the image to the next free slot of the queue */
+int cls_movie::queue_put(u_char *image, const struct timespec *ts1, bool reset)
+{
+    ctx_movie_item *item;
+
+    pthread_mutex_lock(&mutex_queue);
+    while (queue_cnt == queue_max) {
+        if ((queue_block == false) && (reset == false)) {
+            queue_dropped++;
+            pthread_mutex_unlock(&mutex_queue);
+            return 0;
+        }
+        pthread_mutex_unlock(&mutex_queue);
+        if (handler_running == false) {
+            return -1;
+        }
+        evwait_space->wait_for(1, 0);
+        pthread_mutex_lock(&mutex_queue);
+    }
+    item = &queue[(uint)((queue_head + queue_cnt) % queue_max)];
+    pthread_mutex_unlock(&mutex_queue);
+
+    /* The encoder does not touch a slot until it is counted */
+    item->reset = reset;
+    item->imgts = *ts1;
+    item->rate_ofs = rate_ofs;
+    item->roi.swap(roi_next);
+    if (reset == false) {
+        memcpy(item->image, image, queue_sz);
+    }
+
+    pthread_mutex_lock(&mutex_queue);
+        queue_cnt++;
+        queue_peak = MAX(queue_peak, queue_cnt);
+    pthread_mutex_unlock(&mutex_queue);
+
+    evwait_work->wake();
+
+    return 0;
+}
+
+/* Wait for the encoder to finish every queued image */
+void cls_movie::queue_drain()
+{
+    int cnt;
+
+    if (queue_use() == false) {
+        return;
+    }
+
+    pthread_mutex_lock(&mutex_queue);
+        cnt = queue_cnt;
+    pthread_mutex_unlock(&mutex_queue);
+    while ((cnt > 0) && (handler_running == true)) {
+        evwait_space->wait_for(1, 0);
+        pthread_mutex_lock(&mutex_queue);
+            cnt = queue_cnt;
+        pthread_mutex_unlock(&mutex_queue);
+    }
+}
+
+/* Encoder thread processing loop */
+void cls_movie::handler()
+{
+    ctx_movie_item *item;
+
+    mythreadname_set("mv", cam->cfg->device_id, movie_type.c_str());
+
+    while (handler_stop == false) {
+        pthread_mutex_lock(&mutex_queue);
+            if (queue_cnt == 0) {
+                item = nullptr;
+            } else {
+                item = &queue[(uint)queue_head];
+            }
+        pthread_mutex_unlock(&mutex_queue);
+
+        /* Woken by queue_put and handler_shutdown */
+        if (item == nullptr) {
+            evwait_work->wait_until(nullptr);
+            continue;
+        }
+
+        if (item->reset) {
+            reset_pts(&item->imgts);
+        } else {
+            clock_gettime(CLOCK_MONOTONIC, &cb_st_ts);
+            rate_enc = item->rate_ofs;
+            roi_enc.swap(item->roi);
+            if (encode_image(item->image, &item->imgts) == -1) {
+                MOTION_LOG(ERR, TYPE_EVENTS, NO_ERRNO, _("Error encoding image"));
+            }
+        }
+
+        pthread_mutex_lock(&mutex_queue);
+            queue_head = (queue_head + 1) % queue_max;
+            queue_cnt--;
+        pthread_mutex_unlock(&mutex_queue);
+        evwait_space->wake();
+    }
+
+    handler_running = false;
+}
+
+void cls_movie::handler_startup()
+{
+    int retcd;
+    pthread_attr_t thread_attr;
+
+    if ((queue_max == 0) || (handler_running == true)) {
+        return;
+    }
+
+    handler_running = true;
+    handler_stop = false;
+    pthread_attr_init(&thread_attr);
+    pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+    retcd = pthread_create(&handler_thread, &thread_attr, &movie_handler, this);
+    if (retcd != 0) {
+        MOTION_LOG(WRN, TYPE_ENCODER, NO_ERRNO
+            ,_("Unable to start encoder thread.  Encoding on camera loop."));
+        handler_running = false;
+        handler_stop = true;
+    }
+    pthread_attr_destroy(&thread_attr);
+}
+
+void cls_movie::handler_shutdown()
+{
+    int waitcnt;
+
+    if (handler_running == false) {
+        return;
+    }
+
+    handler_stop = true;
+    evwait_work->wake();
+    waitcnt = 0;
+    while ((handler_running == true) && (waitcnt < (cam->cfg->watchdog_tmo * 10))) {
+        SLEEP(0, 100000000L)
+        waitcnt++;
+    }
+    if (handler_running == true) {
+        MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO
+            , _("Normal shutdown of encoder thread failed"));
+        pthread_kill(handler_thread, SIGVTALRM);
+        handler_running = false;
+    }
+}
+
+void cls_movie::init_params()
+{
+    int indx;
+    ctx_params  *params;
+    std::string  pnm, pvl;
+
+    params = new ctx_params;
+    util_parms_parse(params, "movie_params", cam->cfg->movie_params);
+    util_parms_add_default(params, "queue", "10");
+    util_parms_add_default(params, "queue_policy", "block");
+    util_parms_add_default(params, "preroll", "0");
+    util_parms_add_default(params, "timelapse_sync", "60");
+    util_parms_add_default(params, "segment", "0");
+    util_parms_add_default(params, "extpipe_mode", "pipe");
+    util_parms_add_default(params, "extpipe_slots", "4");
+    util_parms_add_default(params, "rate_control", "fixed");
+    util_parms_add_default(params, "rate_range", "6");
+    util_parms_add_default(params, "quiet_fps", "0");
+
+    for (indx=0; indx<params->params_cnt; indx++) {
+        pnm = params->params_array[indx].param_name;
+        pvl = params->params_array[indx].param_value;
+        if (pnm == "queue") {
+            queue_max = mtoi(pvl);
+        }
+        if (pnm == "queue_policy") {
+            queue_block = (pvl != "drop");
+        }
+        if (pnm == "preroll") {
+            preroll_sec = mtoi(pvl);
+        }
+        if (pnm == "timelapse_sync") {
+            tlapse_sync = mtoi(pvl);
+        }
+        if (pnm == "segment") {
+            segment_sec = mtoi(pvl);
+        }
+        if (pnm == "extpipe_mode") {
+            extpipe_shm = (pvl == "shm");
+        }
+        if (pnm == "extpipe_slots") {
+            extpipe_slots = mtoi(pvl);
+        }
+        if (pnm == "rate_control") {
+            rate_adaptive = (pvl == "motion");
+        }
+        if (pnm == "rate_range") {
+            rate_range = mtoi(pvl);
+        }
+        if (pnm == "quiet_fps") {
+            rate_quiet_fps = mtoi(pvl);
+        }
+    }
+    mydelete(params);
+
+    if ((queue_max < 0) || (queue_max > 1000)) {
+        MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO
+            ,_("Invalid movie queue : %d"), queue_max);
+        queue_max = 10;
+    }
+    if ((preroll_sec < 0) || (preroll_sec > 60)) {
+        MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO
+            ,_("Invalid movie preroll : %d"), preroll_sec);
+        preroll_sec = 0;
+    }
+    if (tlapse_sync < 0) {
+        MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO
+            ,_("Invalid movie timelapse_sync : %d"), tlapse_sync);
+        tlapse_sync = 60;
+    }
+    if (segment_sec < 0) {
+        MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO
+            ,_("Invalid movie segment : %d"), segment_sec);
+        segment_sec = 0;
+    }
+    if ((extpipe_slots < 2) || (extpipe_slots > EXTSHM_SLOTS_MAX)) {
+        MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO
+            ,_("Invalid movie extpipe_slots : %d"), extpipe_slots);
+        extpipe_slots = 4;
+    }
+    if ((rate_range < 0) || (rate_range > 20)) {
+        MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO
+            ,_("Invalid movie rate_range : %d"), rate_range);
+        rate_range = 6;
+    }
+    if ((rate_quiet_fps < 0) || (rate_quiet_fps > 100)) {
+        MOTION_LOG(ERR, TYPE_ENCODER, NO_ERRNO
+            ,_("Invalid movie quiet_fps : %d"), rate_quiet_fps);
+        rate_quiet_fps = 0;
+    }
+    if ((segment_sec > 0) && (movie_type == "norm") &&
+        (cam->cfg->movie_passthrough == false)) {
+        MOTION_LOG(NTC, TYPE_ENCODER, NO_ERRNO
+            ,_("Continuous segments require movie_passthrough."));
+    }
+}
+
+void cls_movie::init_container()
+{
+    int codenbr;
+    size_t col_pos;
+
+    if (cam->cfg->movie_container == "test") {
+        MOTION_LOG(NTC, TYPE_ENCODER, NO_ERRNO, "Running test of the various output formats.");
+        codenbr = cam->event_curr_nbr % 6;
+        if (codenbr == 1) {
+            container = "mov";
+        } else if (codenbr == 2) {
+            container = "webm";
+        } else if (codenbr == 3) {
+            container = "mp4";
+        } else if (codenbr == 4) {
+            container = "mkv";
+        } else if (codenbr == 5) {
+            container = "hevc";
+        } else {
+            container = "mp4";
+        }
+    } else {
+        container = cam->cfg->movie_container;
+    }
+
+    col_pos = container.find(":");
+    if (col_pos == std::string::npos) {
+        preferred_codec = "";
+    } else {
+        preferred_codec = container.substr(col_pos+1);
+        container = container.substr(0,col_pos);
+    }
+
+}
+
+void cls_movie::start_norm()
+{
+    char tmp[PATH_MAX];
+
+    if (cam->cfg->movie_output == false) {
+        is_running = false;
+        return;
+    }
+
+    init_container();
+
+    mystrftime(cam, tmp, sizeof(tmp), cam->cfg->movie_filename.c_str(), nullptr);
+
+    file_nm = tmp;
+    if (container =="test") {
+        full_nm = cam->cfg->target_dir + "/"  + container + "_" + file_nm;
+    } else {
+        full_nm = cam->cfg->target_dir + "/"  + file_nm;
+    }
+    file_dir =full_nm.substr(0,full_nm.find_last_of("/"));
+    file_nm = full_nm.substr(file_dir.length()+1);
+    segment_ts = cam->current_image->imgts;
+    segment_pend = segment_use();
+    segment_lag = -1;
+
+    if (preroll_use()) {
+        if (preroll_start() < 0) {
+            MOTION_LOG(ERR, TYPE_EVENTS, NO_ERRNO
+                ,_("Error initializing movie."));
+            return;
+        }
+        on_movie_start();
+        cam->app->dbse->exec(cam, full_nm, "movie_start");
+        is_running = true;
+        return;
+    }
+
+    if (cam->imgs.size_high > 0) {
+        width  = cam->imgs.width_high;
+        height = cam->imgs.height_high;
+        high_resolution = true;
+        netcam_data = cam->netcam_high;
+    } else {
+        width  = cam->imgs.width;
+        height = cam->imgs.height;
+        high_resolution = false;
+        netcam_data = cam->netcam;
+    }
+    pkt = nullptr;
+    tlapse = TIMELAPSE_NONE;
+    fps = cam->lastrate;
+    start_time.tv_sec = cam->current_image->imgts.tv_sec;
+    start_time.tv_nsec = cam->current_image->imgts.tv_nsec;
+    last_pts = -1;
+    base_pts = 0;
+    gop_cnt = 0;
+
+    if (cam->cfg->movie_container == "test") {
+        test_mode = true;
+    } else {
+        test_mode = false;
+    }
+    motion_images = false;
+    passthrough = cam->movie_passthrough;
+
+    if (movie_open() < 0) {
+        MOTION_LOG(ERR, TYPE_EVENTS, NO_ERRNO
+            ,_("Error initializing movie."));
+        return;
+    }
+
+    if (segment_rolling == false) {
+        on_movie_start();
+        cam->app->dbse->exec(cam, full_nm, "movie_start");
+    }
+
+    is_running = true;
+
+}
+
+void cls_movie::start_motion()
+{
+    char tmp[PATH_MAX];
+    ctx_image_data save_data;
+
+    if (cam->cfg->movie_output_motion == false) {
+        is_running = false;
+        return;
+    }
+
+    init_container();
 
     memcpy(&save_data, cam->current_image, sizeof(ctx_image_data));
         memcpy(cam->current_image, &cam->imgs.image_motion, sizeof(ctx_image_data));
@@ -1576,6 +2685,7 @@ void cls_movie::start_timelapse()
     motion_images = false;
     passthrough = false;
     netcam_data = nullptr;
+    clock_gettime(CLOCK_MONOTONIC, &tlapse_sync_ts);
 
     if (cam->cfg->timelapse_container == "mpg") {
         MOTION_LOG(NTC, TYPE_EVENTS, NO_ERRNO, _("Timelapse using mpg container."));
@@ -1603,7 +2713,9 @@ void cls_movie::start_timelapse()
 
 void cls_movie::start_extpipe()
 {
+    int retcd;
     char tmp[PATH_MAX];
+    std::string cmd;
 
     if (cam->cfg->movie_extpipe_use == false) {
         is_running = false;
@@ -1636,9 +2748,31 @@ void cls_movie::start_extpipe()
 
     MOTION_LOG(NTC, TYPE_EVENTS, NO_ERRNO, _("extpipe cmd: %s"), tmp);
 
-    extpipe_stream = popen(tmp, "we");
+    cmd = tmp;
+    if (extpipe_shm) {
+        if ((cam->imgs.size_high > 0) && (cam->movie_passthrough == false)) {
+            retcd = extshm->open(cam->imgs.width_high, cam->imgs.height_high
+                , cam->cfg->framerate, (size_t)cam->imgs.size_high, extpipe_slots);
+        } else {
+            retcd = extshm->open(cam->imgs.width, cam->imgs.height
+                , cam->cfg->framerate, (size_t)cam->imgs.size_norm, extpipe_slots);
+        }
+        if (retcd == 0) {
+            cmd = extshm->env() + cmd;
+        } else {
+            MOTION_LOG(ERR, TYPE_EVENTS, NO_ERRNO
+                , _("Using the pipe for the extpipe images"));
+        }
+    }
+
+    if (extshm->is_open()) {
+        extpipe_stream = extshm->cmd_open(cmd);
+    } else {
+        extpipe_stream = popen(cmd.c_str(), "we");
+    }
     if (extpipe_stream == nullptr) {
         MOTION_LOG(ERR, TYPE_EVENTS, SHOW_ERRNO, _("popen failed"));
+        extshm->close();
         return;
     }
 
@@ -1656,6 +2790,12 @@ void cls_movie::start()
         return;
     }
 
+    cam->storage->movie_check();
+    /* The pre-roll encoder keeps its quality between the movies */
+    if (preroll_use() == false) {
+        rate_reset();
+    }
+
     if (movie_type == "norm") {
         start_norm();
     } else if (movie_type == "motion") {
@@ -1667,6 +2807,10 @@ void cls_movie::start()
     } else {
         MOTION_LOG(ERR, TYPE_EVENTS, NO_ERRNO,_("Invalid movie type"));
     }
+
+    if (is_running == true) {
+        queue_alloc();
+    }
 }
 
 void cls_movie::init_vars()
@@ -1696,6 +2840,7 @@ void cls_movie::init_vars()
     base_pts = 0;
     pass_audio_base = 0;
     pass_video_base = 0;
+    pass_cursor = 0;
     test_mode = false;
     gop_cnt = 5;
     start_time.tv_nsec = 0;
@@ -1707,24 +2852,82 @@ void cls_movie::init_vars()
     nal_info = nullptr;
     nal_info_len = 0;
     extpipe_stream = nullptr;
+    extpipe_shm = false;
+    extpipe_slots = 4;
+    rate_adaptive = false;
+    rate_range = 6;
+    rate_quiet_fps = 0;
+    rate_crf = 0;
+    rate_reset();
+    tlapse_file = nullptr;
+    tlapse_sync = 60;
+    tlapse_sync_ts.tv_sec = 0;
+    tlapse_sync_ts.tv_nsec = 0;
+    segment_sec = 0;
+    segment_ts.tv_sec = 0;
+    segment_ts.tv_nsec = 0;
+    segment_retry = 0;
+    segment_pend = false;
+    segment_lag = -1;
+    segment_rolling = false;
+    evt_active = false;
+    evt_ts.tv_sec = 0;
+    evt_ts.tv_nsec = 0;
     container = "";
     preferred_codec = "";
+    bench_preset = "";
+
+    handler_running = false;
+    handler_stop = true;
+    queue_max = 0;
+    queue_cnt = 0;
+    queue_peak = 0;
+    queue_head = 0;
+    queue_sz = 0;
+    queue_dropped = 0;
+    queue_block = true;
+    preroll_sec = 0;
+    preroll_base = 0;
+    preroll_bytes = 0;
+    preroll_file = false;
+    preroll_ts.tv_sec = 0;
+    preroll_ts.tv_nsec = 0;
 
 }
 
 cls_movie::cls_movie(cls_camera *p_cam, std::string pmovie_type)
 {
+    int indx;
+
     cam = p_cam;
 
     is_running = false;
 
     movie_type = pmovie_type;
+    extshm = new cls_extshm();
 
     init_vars();
+    init_params();
+
+    pthread_mutex_init(&mutex_queue, nullptr);
+    evwait_work = new cls_evwait();
+    evwait_space = new cls_evwait();
+    queue.resize((uint)queue_max);
+    for (indx=0; indx<queue_max; indx++) {
+        queue[(uint)indx].image = nullptr;
+        queue[(uint)indx].reset = false;
+    }
 }
 
 cls_movie::~cls_movie()
 {
-
+    handler_shutdown();
+    preroll_close();
+    timelapse_close();
+    queue_free();
+    mydelete(extshm);
+    mydelete(evwait_work);
+    mydelete(evwait_space);
+    pthread_mutex_destroy(&mutex_queue);
 }
 
@@ -26,6 +26,15 @@ enum TIMELAPSE_TYPE {
     TIMELAPSE_NEW           /* Use create new file version of timelapse */
 };
 
+/* Image waiting for the encoder thread */
+struct ctx_movie_item {
+    u_char          *image;
+    struct timespec imgts;
+    bool            reset;      /* Only reset the start time to imgts */
+    int             rate_ofs;   /* Quality offset chosen for the image */
+    std::vector<ctx_coord> roi; /* Boxes encoded at a higher quality */
+};
+
 
 class cls_movie {
     public:
@@ -35,6 +44,11 @@ class cls_movie {
         void stop();
         int put_image(ctx_image_data *img_data, const struct timespec *ts1);
         void reset_start_time(const struct timespec *ts1);
+        void preroll_put(ctx_image_data *img_data);
+        void event_start();
+        void event_end();
+        void segment_put(ctx_image_data *img_data);
+        void handler();
 
         struct timespec     cb_st_ts;    /* The time set before calling the av functions */
         struct timespec     cb_cr_ts;    /* Time during the interrupt to determine duration since start*/
@@ -44,15 +58,93 @@ class cls_movie {
         std::string         file_dir;
         bool                is_running;
 
+        pthread_mutex_t     mutex_queue;
+        int                 queue_max;      /* Images that may wait.  0=encode on camera loop */
+        int                 queue_cnt;
+        int                 queue_peak;
+        int64_t             queue_dropped;
+        bool                queue_block;    /* Wait for space rather than drop */
+        int64_t             preroll_bytes;  /* Bytes of encoded packets held */
+
     private:
         cls_camera *cam;
 
+        pthread_t                   handler_thread;
+        bool                        handler_running;
+        bool                        handler_stop;
+        cls_evwait                  *evwait_work;   /* Wakes encoder when an image is queued */
+        cls_evwait                  *evwait_space;  /* Wakes camera when the encoder is done */
+        std::vector<ctx_movie_item> queue;
+        int                         queue_head;
+        size_t                      queue_sz;       /* Bytes of each queued image */
+
+        void init_params();
+        void handler_startup();
+        void handler_shutdown();
+        bool queue_use();
+        void queue_alloc();
+        void queue_free();
+        int queue_put(u_char *image, const struct timespec *ts1, bool reset);
+        void queue_drain();
+        u_char *image_src(ctx_image_data *img_data);
+        int encode_image(u_char *image, const struct timespec *ts1);
+        void reset_pts(const struct timespec *ts1);
+
+        int                     preroll_sec;    /* Seconds of packets kept before an event */
+        std::deque<AVPacket*>   preroll_pkts;
+        int64_t                 preroll_base;   /* Encoder pts of the first packet in the file */
+        struct timespec         preroll_ts;     /* Time of encoder pts zero */
+        bool                    preroll_file;   /* Packets are being written to the file */
+        bool preroll_use();
+        int preroll_open(const struct timespec *ts1);
+        void preroll_close();
+        int preroll_encode(u_char *image, const struct timespec *ts1);
+        void preroll_write(AVPacket *p_pkt);
+        void preroll_trim();
+        int preroll_start();
+        void preroll_stop();
+
+        int                 segment_sec;    /* Seconds of each continuous segment */
+        struct timespec     segment_ts;     /* Time of the first image in the segment */
+        time_t              segment_retry;
+        bool                segment_pend;   /* segment_ts waits for the first key packet */
+        int64_t             segment_lag;    /* Nanoseconds from that key packet to the image */
+        bool                segment_rolling;/* Between segments so the movie hooks are skipped */
+        bool                evt_active;     /* Event in progress within the segments */
+        struct timespec     evt_ts;         /* Start of the event in the current segment */
+        bool segment_use();
+        int64_t segment_key(ctx_image_data *img_data);
+        int64_t segment_span(int64_t key_id, int64_t img_id);
+        void segment_begin(ctx_image_data *img_data);
+        void segment_roll();
+        void segment_seek(int64_t key_id);
+        void segment_event(const struct timespec *ts_end);
+
+        bool                rate_adaptive;  /* Quality follows the motion in the images */
+        int                 rate_range;     /* Largest change of the crf/qscale */
+        int                 rate_quiet_fps; /* Images per second kept without motion */
+        int                 rate_crf;       /* crf chosen from movie_quality */
+        double              rate_level;     /* Smoothed motion relative to threshold */
+        int                 rate_ofs;       /* Offset for the next image from the camera */
+        int                 rate_enc;       /* Offset for the image being encoded */
+        int                 rate_cur;       /* Offset currently set on the encoder */
+        int                 rate_ok;        /* Encoder adapts the quality. -1=not yet checked */
+        struct timespec     rate_ts;        /* Monotonic time of the last kept image */
+        std::vector<ctx_coord> roi_next;   /* Boxes of the next image from the camera */
+        std::vector<ctx_coord> roi_enc;    /* Boxes of the image being encoded */
+        bool rate_use();
+        void rate_reset();
+        bool rate_keep(ctx_image_data *img_data);
+        void rate_apply();
+
         void free_pkt();
         void free_nal();
         void encode_nal();
         int timelapse_exists(const char *fname);
         int encode_video();
         int timelapse_append(AVPacket *pkt);
+        void timelapse_checkpoint(bool force);
+        void timelapse_close();
         void free_context();
         int get_oformat();
         int set_pts(const struct timespec *ts1);
@@ -65,16 +157,17 @@ class cls_movie {
         int set_outputfile();
         int flush_codec();
         int put_frame(const struct timespec *ts1);
-        void put_pix_yuv420(ctx_image_data *img_data);
+        void put_pix_yuv420(u_char *image);
         int movie_open();
         void init_container();
         void init_vars();
 
         void passthru_reset();
         int passthru_pktpts();
-        void passthru_write(int indx);
+        void passthru_write(AVPacket *p_pkt);
         void passthru_minpts();
         int passthru_put(ctx_image_data *img_data);
+        int passthru_upto(int64_t idnbr_image);
         int passthru_streams_video(AVStream *stream_in);
         int passthru_streams_audio(AVStream *stream_in);
         int passthru_streams();
@@ -85,7 +178,7 @@ class cls_movie {
         void start_motion();
         void start_timelapse();
         void start_extpipe();
-        int extpipe_put();
+        int extpipe_put(u_char *image, const struct timespec *ts1);
         void on_movie_start();
         void on_movie_end();
 
@@ -106,6 +199,7 @@ class cls_movie {
         int64_t             base_pts;
         int64_t             pass_audio_base;
         int64_t             pass_video_base;
+        int64_t             pass_cursor;    /* idnbr of the last packet written */
         bool                test_mode;
         int                 gop_cnt;
         struct timespec     start_time;
@@ -116,8 +210,15 @@ class cls_movie {
         char                *nal_info;
         int                 nal_info_len;
         FILE                *extpipe_stream;
+        cls_extshm          *extshm;        /* Frames for the extpipe in shared memory */
+        bool                extpipe_shm;
+        int                 extpipe_slots;
+        FILE                *tlapse_file;   /* Held open while appending */
+        int                 tlapse_sync;    /* Seconds between checkpoints */
+        struct timespec     tlapse_sync_ts;
         std::string         container;
         std::string         preferred_codec;
+        std::string         bench_preset;   /* Preset recorded with the benchmarked codec */
         std::string         movie_type;
 
 };
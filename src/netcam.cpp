@@ -430,27 +430,67 @@ void cls_netcam::context_close()
     context_null();
 }
 
+/* Index in the array of the packet with the id or -1 if it is no
+ * longer in the ring.  Packets are stored in idnbr order so the index
+ * is found directly.  The mutex_pktarray must be locked by the caller.
+ */
+int cls_netcam::pktarray_slot(int64_t pkt_idnbr)
+{
+    int64_t back;
+    int indx;
+
+    if ((pktarray_size == 0) || (pktarray_index < 0)) {
+        return -1;
+    }
+    back = pktarray[pktarray_index].idnbr - pkt_idnbr;
+    if ((back < 0) || (back >= pktarray_size)) {
+        return -1;
+    }
+    indx = pktarray_index - (int)back;
+    if (indx < 0) {
+        indx += pktarray_size;
+    }
+    if (pktarray[indx].idnbr != pkt_idnbr) {
+        return -1;
+    }
+    return indx;
+}
+
+/* Id of the oldest packet held.  The mutex_pktarray must be locked. */
+int64_t cls_netcam::pktarray_oldest()
+{
+    int indx;
+
+    if ((pktarray_size == 0) || (pktarray_index < 0)) {
+        return 0;
+    }
+    indx = pktarray_index + 1;
+    if (indx == pktarray_size) {
+        indx = 0;
+    }
+    if (pktarray[indx].idnbr == 0) {
+        indx = 0;
+    }
+    return pktarray[indx].idnbr;
+}
+
 void cls_netcam::pktarray_resize()
 {
     /* This is called from next and is on the motion loop thread
      * The mutex is locked around the call to this function.
     */
 
-    /* Remember that this is a ring and we have two threads chasing around it
-     * the ffmpeg is writing out of this ring while we are filling it up.  "Bad"
-     * things will occur if the "add" thread catches up with the "write" thread.
-     * We need this ring to be big enough so they don't collide.
-     * The alternative is that we'd need to make a copy of the entire packet
-     * array in the ffmpeg module and do our writing from that copy.  The
-     * downside is that is a lot to be copying around for each image we want
-     * to write out.  And putting a mutex on the array during adding function would
-     * slow down the capture thread to the speed of the writing thread.  And that
-     * writing thread operates at the user specified FPS which could be really slow
-     * ...So....make this array big enough so we never catch our tail.  :)
+    /* The ring is written by the netcam thread and read by the movie
+     * writers.  Readers only hold the mutex long enough to take their own
+     * reference to the packets they need and keep a cursor of the last id
+     * they wrote, so the ring must hold at least the packets between the
+     * oldest image in the precapture ring and the newest packet.
+     * When it grows, the packets are copied oldest first so that the ring
+     * stays in idnbr order and pktarray_slot can find any packet directly.
      */
 
     int64_t         idnbr_last, idnbr_first;
-    int             indx;
+    int             indx, indx_src, cnt;
     ctx_packet_item *tmp;
     int             newsize;
 
@@ -477,20 +517,37 @@ void cls_netcam::pktarray_resize()
     pthread_mutex_lock(&mutex_pktarray);
         if ((pktarray_size < newsize) ||  (pktarray_size < 30)) {
             tmp =(ctx_packet_item*) mymalloc((uint)newsize * sizeof(ctx_packet_item));
+            cnt = 0;
             if (pktarray_size > 0 ) {
-                memcpy(tmp, pktarray, sizeof(ctx_packet_item) * (uint)pktarray_size);
+                indx_src = pktarray_index + 1;
+                for (indx = 0; indx < pktarray_size; indx++) {
+                    if (indx_src == pktarray_size) {
+                        indx_src = 0;
+                    }
+                    if (pktarray[indx_src].idnbr != 0) {
+                        tmp[cnt++] = pktarray[indx_src];
+                    } else {
+                        av_packet_free(&pktarray[indx_src].packet);
+                    }
+                    indx_src++;
+                }
             }
-            for(indx = pktarray_size; indx < newsize; indx++) {
+            for(indx = cnt; indx < newsize; indx++) {
                 tmp[indx].packet = nullptr;
                 tmp[indx].packet = mypacket_alloc(tmp[indx].packet);
                 tmp[indx].idnbr = 0;
+                tmp[indx].keynbr = 0;
                 tmp[indx].iskey = false;
-                tmp[indx].iswritten = false;
             }
 
             myfree(pktarray);
             pktarray = tmp;
             pktarray_size = newsize;
+            if (cnt > 0) {
+                pktarray_index = cnt - 1;
+            } else {
+                pktarray_index = -1;
+            }
 
             MOTION_LOG(INF, TYPE_NETCAM, NO_ERRNO
                 , _("%s:Resized packet array to %d")
@@ -504,14 +561,30 @@ void cls_netcam::pktarray_add()
     int indx_next;
     int retcd;
     char errstr[128];
+    AVPacket *pkt_new, *pkt_old;
+    bool iskey;
 
-    pthread_mutex_lock(&mutex_pktarray);
+    if (pktarray_size == 0) {
+        return;
+    }
 
-        if (pktarray_size == 0) {
-            pthread_mutex_unlock(&mutex_pktarray);
-            return;
-        }
+    /* Reference the packet before taking the lock.  A failed packet is
+     * kept as an empty packet so that the ring stays in idnbr order.
+     */
+    pkt_new = mypacket_alloc(nullptr);
+    retcd = av_packet_ref(pkt_new, packet_recv);
+    if ((interrupted) || (retcd < 0)) {
+        av_strerror(retcd, errstr, sizeof(errstr));
+        MOTION_LOG(INF, TYPE_NETCAM, NO_ERRNO
+            ,_("%s:av_copy_packet:%s ,Interrupt:%s")
+            ,cameratype.c_str()
+            ,errstr, interrupted ? _("true"):_("false"));
+        pkt_new = mypacket_alloc(pkt_new);
+    }
+    iskey = ((pkt_new->flags & AV_PKT_FLAG_KEY) &&
+        (pkt_new->stream_index == video_stream_index));
 
+    pthread_mutex_lock(&mutex_pktarray);
         /* Recall pktarray_size is one based but pktarray is zero based */
         if (pktarray_index == (pktarray_size-1)) {
             indx_next = 0;
@@ -519,32 +592,24 @@ void cls_netcam::pktarray_add()
             indx_next = pktarray_index + 1;
         }
 
+        pkt_old = pktarray[indx_next].packet;
+        pktarray[indx_next].packet = pkt_new;
         pktarray[indx_next].idnbr = idnbr;
-
-        av_packet_free(&pktarray[indx_next].packet);
-        pktarray[indx_next].packet = nullptr;
-        pktarray[indx_next].packet = mypacket_alloc(pktarray[indx_next].packet);
-
-        retcd = av_packet_ref(pktarray[indx_next].packet, packet_recv);
-        if ((interrupted) || (retcd < 0)) {
-            av_strerror(retcd, errstr, sizeof(errstr));
-            MOTION_LOG(INF, TYPE_NETCAM, NO_ERRNO
-                ,_("%s:av_copy_packet:%s ,Interrupt:%s")
-                ,cameratype.c_str()
-                ,errstr, interrupted ? _("true"):_("false"));
-            av_packet_free(&pktarray[indx_next].packet);
-            pktarray[indx_next].packet = nullptr;
-        }
-
-        if (pktarray[indx_next].packet->flags & AV_PKT_FLAG_KEY) {
-            pktarray[indx_next].iskey = true;
+        pktarray[indx_next].iskey = iskey;
+        if (iskey) {
+            pktarray[indx_next].keynbr = idnbr;
+        } else if ((pktarray_index >= 0) &&
+            (pktarray[pktarray_index].idnbr == (idnbr - 1))) {
+            pktarray[indx_next].keynbr = pktarray[pktarray_index].keynbr;
         } else {
-            pktarray[indx_next].iskey = false;
+            pktarray[indx_next].keynbr = 0;
         }
-        pktarray[indx_next].iswritten = false;
 
         pktarray_index = indx_next;
     pthread_mutex_unlock(&mutex_pktarray);
+
+    /* Readers hold their own references so this only drops ours */
+    av_packet_free(&pkt_old);
 }
 
 int cls_netcam::decode_sw()
@@ -60,8 +60,8 @@ typedef netcam_buff *netcam_buff_ptr;
 struct ctx_packet_item{
     AVPacket                 *packet;
     int64_t                   idnbr;
+    int64_t                   keynbr;   /* idnbr of the last video key frame at or before the packet */
     bool                      iskey;
-    bool                      iswritten;
 };
 
 struct ctx_filelist_item {
@@ -91,6 +91,7 @@ class cls_netcam {
         AVFormatContext          *transfer_format;       /* Format context just for transferring to pass-through */
         ctx_packet_item          *pktarray;              /* Pointer to array of packets for passthru processing */
         int                       pktarray_size;         /* The number of packets in array.  1 based */
+        int                       pktarray_index;        /* The index to the most current packet in array */
         int                       video_stream_index;       /* Stream index associated with video from camera */
         int                       audio_stream_index;       /* Stream index associated with audio from camera */
 
@@ -100,6 +101,8 @@ class cls_netcam {
         void            handler();
 
         int next(ctx_image_data *img_data);
+        int pktarray_slot(int64_t pkt_idnbr);
+        int64_t pktarray_oldest();
         void noimage();
         void netcam_start();
         void netcam_stop();
@@ -114,7 +117,6 @@ class cls_netcam {
         struct SwsContext        *swsctx;                /* Context for the resizing of the image */
         AVPacket                 *packet_recv;           /* The packet that is currently being processed */
 
-        int                       pktarray_index;        /* The index to the most current packet in array */
         int64_t                   idnbr;                 /* A ID number to track the packet vs image */
         AVDictionary             *opts;                  /* AVOptions when opening the format context */
         int                       swsframe_size;         /* The size of the image after resizing */
@@ -53,6 +53,7 @@ struct ctx_parm_app {
     int             log_fflevel;
     int             log_type;
     bool            native_language;
+    std::string     encoder_file;
 
     /* Webcontrol parameters (PARM_CAT_13) */
     int             webcontrol_port;
@@ -126,6 +127,7 @@ struct ctx_parm_cam {
     std::string     pause;
     std::string     schedule_params;
     std::string     cleandir_params;
+    std::string     storage_params;
 
     /* Source parameters (PARM_CAT_02) */
     std::string     v4l2_device;
@@ -138,6 +140,8 @@ struct ctx_parm_cam {
     std::string     libcam_device;
     std::string     libcam_params;
     int             libcam_buffer_count;
+    int             libcam_lores_width;
+    int             libcam_lores_height;
     float           libcam_brightness;
     float           libcam_contrast;
     int             libcam_iso;
@@ -158,6 +162,7 @@ struct ctx_parm_cam {
     int             width;
     int             height;
     int             framerate;
+    std::string     framerate_policy;
     int             rotate;
     std::string     flip_axis;
 
@@ -231,6 +236,7 @@ struct ctx_parm_cam {
     int             movie_max_time;
     int             movie_bps;
     int             movie_quality;
+    int             movie_roi;
     std::string     movie_encoder_preset;
     std::string     movie_container;
     bool            movie_passthrough;
@@ -239,6 +245,7 @@ struct ctx_parm_cam {
     bool            movie_all_frames;
     bool            movie_extpipe_use;
     std::string     movie_extpipe;
+    std::string     movie_params;
 
     /* Timelapse parameters (PARM_CAT_11) */
     int             timelapse_interval;
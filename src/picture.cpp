@@ -24,6 +24,7 @@
 #include "jpegutils.hpp"
 #include "draw.hpp"
 #include "dbse.hpp"
+#include "storage.hpp"
 #include "picture.hpp"
 
 
@@ -52,6 +53,8 @@ void cls_picture::on_picture_save_command(char *fname)
 {
     MOTION_LOG(NTC, TYPE_EVENTS, NO_ERRNO, _("File saved to: %s"), fname);
 
+    cam->storage->file_saved(fname, false);
+
     if (cam->cfg->on_picture_save != "") {
         util_exec_command(cam, cam->cfg->on_picture_save.c_str(), fname);
     }
@@ -792,6 +795,13 @@ void cls_picture::init_privacy()
                         }
                     }
                 }
+                if (indx_img == 1) {
+                    init_privacy_spans(&cam->imgs.privacy_spans
+                        , img_temp, indx_width, indx_height);
+                } else {
+                    init_privacy_spans(&cam->imgs.privacy_spans_high
+                        , img_temp, indx_width, indx_height);
+                }
                 indx_img++;
             }
         }
@@ -799,6 +809,66 @@ void cls_picture::init_privacy()
 
 }
 
+/* Count or record the runs of 0x00 in the plane.  Returns the count */
+static int privacy_runs(const u_char *plane, int size, ctx_mask_span *spans)
+{
+    int indx, cnt, st;
+
+    cnt = 0;
+    indx = 0;
+    while (indx < size) {
+        if (plane[indx] != 0x00) {
+            indx++;
+            continue;
+        }
+        st = indx;
+        while ((indx < size) && (plane[indx] == 0x00)) {
+            indx++;
+        }
+        if (spans != NULL) {
+            spans[cnt].offset = st;
+            spans[cnt].length = indx - st;
+        }
+        cnt++;
+    }
+    return cnt;
+}
+
+/*
+ * Convert the privacy mask into the runs that are masked so each image
+ * only touches the masked bytes.  A mask with many short runs (e.g. a
+ * dither pattern) is left to the full mask instead.
+ */
+void cls_picture::init_privacy_spans(ctx_mask_spans *spans
+    , u_char *mask, int width, int height)
+{
+    int size_y, size_uv;
+
+    size_y = width * height;
+    size_uv = size_y / 4;
+
+    spans->y = NULL;
+    spans->uv = NULL;
+    spans->y_cnt = privacy_runs(mask, size_y, NULL);
+    spans->uv_cnt = privacy_runs(mask + size_y, size_uv, NULL);
+
+    if ((spans->y_cnt * 64) > size_y) {
+        MOTION_LOG(INF, TYPE_ALL, NO_ERRNO
+            ,_("Privacy mask has %d runs.  Applying the full mask"), spans->y_cnt);
+        spans->y_cnt = 0;
+        spans->uv_cnt = 0;
+        return;
+    }
+
+    spans->y =(ctx_mask_span*) mymalloc(sizeof(ctx_mask_span) * (uint)MAX(spans->y_cnt, 1));
+    spans->uv =(ctx_mask_span*) mymalloc(sizeof(ctx_mask_span) * (uint)MAX(spans->uv_cnt, 1));
+    privacy_runs(mask, size_y, spans->y);
+    privacy_runs(mask + size_y, size_uv, spans->uv);
+
+    MOTION_LOG(INF, TYPE_ALL, NO_ERRNO
+        ,_("Privacy mask of %dx%d applied as %d runs"), width, height, spans->y_cnt);
+}
+
 void cls_picture::init_mask()
 {
     FILE *picture;
@@ -65,6 +65,7 @@ class cls_picture {
         u_char *load_pgm(FILE *picture, int width, int height);
         void write_mask(const char *file);
         void init_privacy();
+        void init_privacy_spans(ctx_mask_spans *spans, u_char *mask, int width, int height);
         void init_mask();
         void init_cfg();
         void on_picture_save_command(char *fname);
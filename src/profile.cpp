@@ -0,0 +1,162 @@
+/*
+ *    This file is part of Motion.
+ *
+ *    Motion is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Motion is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Motion.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "motion.hpp"
+#include "util.hpp"
+#include "profile.hpp"
+
+const char *cls_profile::stage_name(int stage)
+{
+    static const char *names[PROF_STAGE_CNT] = {
+        "capture", "convert", "detection", "diff", "tuning", "overlay", "actions"
+        , "ring_process", "movie", "snapshot", "timelapse", "loopback"
+        , "frame", "stream"
+    };
+
+    if ((stage < 0) || (stage >= PROF_STAGE_CNT)) {
+        return "";
+    }
+    return names[stage];
+}
+
+int64_t cls_profile::now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t)ts.tv_sec * 1000000000L) + ts.tv_nsec;
+}
+
+int cls_profile::bucket(int64_t usec)
+{
+    int msb, indx;
+
+    if (usec < PROF_SUB_CNT) {
+        return (int)MAX(usec, 0);
+    }
+    msb = 63 - __builtin_clzll((unsigned long long)usec);
+    indx = ((msb - PROF_SUB_BITS + 1) * PROF_SUB_CNT) +
+        (int)((usec >> (msb - PROF_SUB_BITS)) & (PROF_SUB_CNT - 1));
+    return MIN(indx, PROF_BUCKETS - 1);
+}
+
+/* Upper value of the bucket so percentiles are not under reported */
+int64_t cls_profile::bucket_value(int indx)
+{
+    int msb, sub;
+
+    if (indx < PROF_SUB_CNT) {
+        return indx;
+    }
+    msb = (indx / PROF_SUB_CNT) + PROF_SUB_BITS - 1;
+    sub = indx % PROF_SUB_CNT;
+    return (((int64_t)(PROF_SUB_CNT + sub + 1)) << (msb - PROF_SUB_BITS)) - 1;
+}
+
+/* Start timing a sequence of stages with mark */
+void cls_profile::begin()
+{
+    mark_ns = now();
+}
+
+/* Record the time since the previous mark against the stage */
+void cls_profile::mark(enum PROF_STAGE stage)
+{
+    int64_t start_ns;
+
+    start_ns = mark_ns;
+    mark_ns = now();
+    record(stage, start_ns);
+}
+
+void cls_profile::record(enum PROF_STAGE stage, int64_t start_ns)
+{
+    ctx_prof_histo *hst = &histo[stage];
+    int64_t usec, prev;
+
+    usec = (now() - start_ns) / 1000;
+    hst->count[bucket(usec)].fetch_add(1, std::memory_order_relaxed);
+    hst->total.fetch_add(1, std::memory_order_relaxed);
+    prev = hst->max.load(std::memory_order_relaxed);
+    while ((usec > prev) &&
+        (hst->max.compare_exchange_weak(prev, usec
+            , std::memory_order_relaxed) == false)) {
+    }
+}
+
+uint64_t cls_profile::count(int stage)
+{
+    return histo[stage].total.load(std::memory_order_relaxed);
+}
+
+int64_t cls_profile::max(int stage)
+{
+    return histo[stage].max.load(std::memory_order_relaxed);
+}
+
+/* Microseconds at or below which pct percent of the samples fall */
+int64_t cls_profile::percentile(int stage, double pct)
+{
+    uint64_t cnt[PROF_BUCKETS];
+    uint64_t tot, want, seen;
+    int indx;
+
+    tot = 0;
+    for (indx=0; indx<PROF_BUCKETS; indx++) {
+        cnt[indx] = histo[stage].count[indx].load(std::memory_order_relaxed);
+        tot += cnt[indx];
+    }
+    if (tot == 0) {
+        return 0;
+    }
+
+    want = (uint64_t)(((double)tot * pct / 100.0) + 0.5);
+    want = MAX(want, 1);
+    seen = 0;
+    for (indx=0; indx<PROF_BUCKETS; indx++) {
+        seen += cnt[indx];
+        if (seen >= want) {
+            return MIN(bucket_value(indx), max(stage));
+        }
+    }
+    return max(stage);
+}
+
+void cls_profile::reset()
+{
+    int indx, stage;
+
+    for (stage=0; stage<PROF_STAGE_CNT; stage++) {
+        for (indx=0; indx<PROF_BUCKETS; indx++) {
+            histo[stage].count[indx].store(0, std::memory_order_relaxed);
+        }
+        histo[stage].total.store(0, std::memory_order_relaxed);
+        histo[stage].max.store(0, std::memory_order_relaxed);
+    }
+}
+
+cls_profile::cls_profile()
+{
+    reset();
+    mark_ns = now();
+}
+
+cls_profile::~cls_profile()
+{
+
+}
@@ -0,0 +1,86 @@
+/*
+ *    This file is part of Motion.
+ *
+ *    Motion is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Motion is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Motion.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _INCLUDE_PROFILE_HPP_
+#define _INCLUDE_PROFILE_HPP_
+
+#include <atomic>
+
+/* Stages of the camera loop and web stream that are timed */
+enum PROF_STAGE {
+    PROF_CAPTURE,
+    PROF_CONVERT,
+    PROF_DETECT,
+    PROF_DIFF,
+    PROF_TUNING,
+    PROF_OVERLAY,
+    PROF_ACTIONS,
+    PROF_RING,
+    PROF_MOVIE,
+    PROF_SNAPSHOT,
+    PROF_TIMELAPSE,
+    PROF_LOOPBACK,
+    PROF_FRAME,
+    PROF_STREAM,
+    PROF_STAGE_CNT
+};
+
+/*
+ * Sixteen linear sub buckets per power of two of microseconds which keeps
+ * each value within about 6% up to 2^27us.  Longer values go to the last
+ * bucket but the exact maximum is kept separately.
+ */
+#define PROF_SUB_BITS   4
+#define PROF_SUB_CNT    (1 << PROF_SUB_BITS)
+#define PROF_BUCKETS    ((27 - PROF_SUB_BITS + 1) * PROF_SUB_CNT)
+
+struct ctx_prof_histo {
+    std::atomic<uint64_t>   count[PROF_BUCKETS];
+    std::atomic<uint64_t>   total;
+    std::atomic<int64_t>    max;
+};
+
+/*
+ * Latency histograms for one camera.  Recording only uses relaxed atomic
+ * increments so the camera and stream threads never block each other or
+ * the web thread reading the results.
+ */
+class cls_profile {
+    public:
+        cls_profile();
+        ~cls_profile();
+
+        static const char *stage_name(int stage);
+        int64_t now();
+        void begin();
+        void mark(enum PROF_STAGE stage);
+        void record(enum PROF_STAGE stage, int64_t start_ns);
+        uint64_t count(int stage);
+        int64_t percentile(int stage, double pct);
+        int64_t max(int stage);
+        void reset();
+
+    private:
+        ctx_prof_histo  histo[PROF_STAGE_CNT];
+        int64_t         mark_ns;    /* Camera thread only */
+
+        int bucket(int64_t usec);
+        int64_t bucket_value(int indx);
+};
+
+#endif /*_INCLUDE_PROFILE_HPP_*/
@@ -38,88 +38,284 @@
 #else
     #include <byteswap.h>
 #endif
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+
+/*
+ * Flips and rotations are combined into a single transform of each
+ * plane.  Rotating by 90 or 270 degrees is a transpose with the rows
+ * and/or columns of the source read in reverse, done in 8x8 blocks
+ * inside larger tiles so both the reads and the writes stay in cache.
+ * Rotating by 0 or 180 degrees only mirrors rows and columns in place.
+ */
+#define ROTATE_TILE     64
 
-void cls_rotate::reverse_inplace_quad(u_char *src, int size)
+/* Reverse the bytes from x to n of the buffer ending at back */
+static void reverse_c(u_char *front, u_char *back, int x, int n)
 {
-    u_char *front = src;
-    u_char *back = src + size - 4;
     uint32_t tmp_front, tmp_back;
+    u_char tmp;
 
-    while (front < back) {
+    /* Four bytes at a time from both ends while they do not overlap */
+    for (; (x + 8) <= n; x += 8) {
         memcpy(&tmp_front, front, sizeof(uint32_t));
-        memcpy(&tmp_back, back, sizeof(uint32_t));
+        memcpy(&tmp_back, back - 4, sizeof(uint32_t));
         tmp_front = bswap_32(tmp_front);
         tmp_back = bswap_32(tmp_back);
         memcpy(front, &tmp_back, sizeof(uint32_t));
-        memcpy(back, &tmp_front, sizeof(uint32_t));
+        memcpy(back - 4, &tmp_front, sizeof(uint32_t));
         front += 4;
         back -= 4;
     }
+    for (; (x + 2) <= n; x += 2) {
+        tmp = *front;
+        *front++ = *--back;
+        *back = tmp;
+    }
 }
 
-void cls_rotate::flip_inplace_horizontal(u_char *src, int width, int height)
+/* Transpose an 8x8 block.  rows[] are the source rows at column x0 */
+static void turn_8x8_c(const u_char **rows, int x0, u_char *dst, int dst_w, bool rev)
 {
-    uint8_t *nsrc, *ndst;
-    uint8_t tmp;
-    int l,w;
-
-    for(l=0; l < height/2; l++) {
-        nsrc = (uint8_t *)(src + l*width);
-        ndst = (uint8_t *)(src + (width*(height-l-1)));
-        for(w=0; w < width; w++) {
-            tmp =*ndst;
-            *ndst++ = *nsrc;
-            *nsrc++ = tmp;
+    int r, c;
+
+    for (r = 0; r < 8; r++) {
+        for (c = 0; c < 8; c++) {
+            dst[(rev ? (7 - r) : r) * dst_w + c] = rows[c][x0 + r];
         }
     }
+}
 
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse2")))
+static void turn_8x8_sse2(const u_char **rows, int x0, u_char *dst, int dst_w, bool rev)
+{
+    __m128i a0, a1, a2, a3, b0, b1, b2, b3, c0, c1, c2, c3;
+    __m128i col[4];
+    int r;
+
+    a0 = _mm_unpacklo_epi8(
+        _mm_loadl_epi64((const __m128i *)(rows[0] + x0)),
+        _mm_loadl_epi64((const __m128i *)(rows[1] + x0)));
+    a1 = _mm_unpacklo_epi8(
+        _mm_loadl_epi64((const __m128i *)(rows[2] + x0)),
+        _mm_loadl_epi64((const __m128i *)(rows[3] + x0)));
+    a2 = _mm_unpacklo_epi8(
+        _mm_loadl_epi64((const __m128i *)(rows[4] + x0)),
+        _mm_loadl_epi64((const __m128i *)(rows[5] + x0)));
+    a3 = _mm_unpacklo_epi8(
+        _mm_loadl_epi64((const __m128i *)(rows[6] + x0)),
+        _mm_loadl_epi64((const __m128i *)(rows[7] + x0)));
+
+    b0 = _mm_unpacklo_epi16(a0, a1);
+    b1 = _mm_unpackhi_epi16(a0, a1);
+    b2 = _mm_unpacklo_epi16(a2, a3);
+    b3 = _mm_unpackhi_epi16(a2, a3);
+
+    c0 = _mm_unpacklo_epi32(b0, b2);
+    c1 = _mm_unpackhi_epi32(b0, b2);
+    c2 = _mm_unpacklo_epi32(b1, b3);
+    c3 = _mm_unpackhi_epi32(b1, b3);
+
+    /* Each register now holds two columns of the source */
+    col[0] = c0;
+    col[1] = c1;
+    col[2] = c2;
+    col[3] = c3;
+    for (r = 0; r < 4; r++) {
+        _mm_storel_epi64((__m128i *)(dst + ((rev ? (7 - (2 * r)) : (2 * r)) * dst_w))
+            , col[r]);
+        _mm_storel_epi64((__m128i *)(dst + ((rev ? (6 - (2 * r)) : ((2 * r) + 1)) * dst_w))
+            , _mm_unpackhi_epi64(col[r], col[r]));
+    }
 }
 
-void cls_rotate::flip_inplace_vertical(u_char *src, int width, int height)
+/* Reverse 16 bytes at a time from both ends.  Returns the bytes done */
+__attribute__((target("sse2")))
+static int reverse_sse2(u_char *front, u_char *back, int n)
 {
-    uint8_t *nsrc, *ndst;
-    uint8_t tmp;
-    int l;
-
-    for(l=0; l < height; l++) {
-        nsrc = (uint8_t *)src + l*width;
-        ndst = nsrc + width - 1;
-        while (nsrc < ndst) {
-            tmp = *ndst;
-            *ndst-- = *nsrc;
-            *nsrc++ = tmp;
-        }
+    __m128i f, b;
+    int x;
+
+    for (x = 0; (x + 32) <= n; x += 32) {
+        f = _mm_loadu_si128((const __m128i *)front);
+        b = _mm_loadu_si128((const __m128i *)(back - 16));
+        f = _mm_shuffle_epi32(f, _MM_SHUFFLE(0, 1, 2, 3));
+        b = _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 1, 2, 3));
+        f = _mm_shufflehi_epi16(_mm_shufflelo_epi16(f, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+        b = _mm_shufflehi_epi16(_mm_shufflelo_epi16(b, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+        f = _mm_or_si128(_mm_slli_epi16(f, 8), _mm_srli_epi16(f, 8));
+        b = _mm_or_si128(_mm_slli_epi16(b, 8), _mm_srli_epi16(b, 8));
+        _mm_storeu_si128((__m128i *)front, b);
+        _mm_storeu_si128((__m128i *)(back - 16), f);
+        front += 16;
+        back -= 16;
     }
+    return x;
 }
 
-void cls_rotate::rot90cw(u_char *src, u_char *dst, int size, int width, int height)
+#elif defined(__ARM_NEON)
+
+static void turn_8x8_neon(const u_char **rows, int x0, u_char *dst, int dst_w, bool rev)
 {
-    u_char *endp;
-    u_char *base;
-    int j;
+    uint8x8x2_t t01, t23, t45, t67;
+    uint16x4x2_t u02, u13, u46, u57;
+    uint32x2x2_t v04, v15, v26, v37;
+    uint8x8_t col[8];
+    int r;
+
+    t01 = vtrn_u8(vld1_u8(rows[0] + x0), vld1_u8(rows[1] + x0));
+    t23 = vtrn_u8(vld1_u8(rows[2] + x0), vld1_u8(rows[3] + x0));
+    t45 = vtrn_u8(vld1_u8(rows[4] + x0), vld1_u8(rows[5] + x0));
+    t67 = vtrn_u8(vld1_u8(rows[6] + x0), vld1_u8(rows[7] + x0));
+
+    u02 = vtrn_u16(vreinterpret_u16_u8(t01.val[0]), vreinterpret_u16_u8(t23.val[0]));
+    u13 = vtrn_u16(vreinterpret_u16_u8(t01.val[1]), vreinterpret_u16_u8(t23.val[1]));
+    u46 = vtrn_u16(vreinterpret_u16_u8(t45.val[0]), vreinterpret_u16_u8(t67.val[0]));
+    u57 = vtrn_u16(vreinterpret_u16_u8(t45.val[1]), vreinterpret_u16_u8(t67.val[1]));
+
+    v04 = vtrn_u32(vreinterpret_u32_u16(u02.val[0]), vreinterpret_u32_u16(u46.val[0]));
+    v26 = vtrn_u32(vreinterpret_u32_u16(u02.val[1]), vreinterpret_u32_u16(u46.val[1]));
+    v15 = vtrn_u32(vreinterpret_u32_u16(u13.val[0]), vreinterpret_u32_u16(u57.val[0]));
+    v37 = vtrn_u32(vreinterpret_u32_u16(u13.val[1]), vreinterpret_u32_u16(u57.val[1]));
+
+    col[0] = vreinterpret_u8_u32(v04.val[0]);
+    col[1] = vreinterpret_u8_u32(v15.val[0]);
+    col[2] = vreinterpret_u8_u32(v26.val[0]);
+    col[3] = vreinterpret_u8_u32(v37.val[0]);
+    col[4] = vreinterpret_u8_u32(v04.val[1]);
+    col[5] = vreinterpret_u8_u32(v15.val[1]);
+    col[6] = vreinterpret_u8_u32(v26.val[1]);
+    col[7] = vreinterpret_u8_u32(v37.val[1]);
+    for (r = 0; r < 8; r++) {
+        vst1_u8(dst + ((rev ? (7 - r) : r) * dst_w), col[r]);
+    }
+}
 
-    endp = src + size;
-    for (base = endp - width; base < endp; base++) {
-        src = base;
-        for (j = 0; j < height; j++, src -= width)
-            *dst++ = *src;
+static inline uint8x16_t reverse_16_neon(uint8x16_t v)
+{
+    v = vrev64q_u8(v);
+    return vcombine_u8(vget_high_u8(v), vget_low_u8(v));
+}
 
+static int reverse_neon(u_char *front, u_char *back, int n)
+{
+    uint8x16_t f, b;
+    int x;
+
+    for (x = 0; (x + 32) <= n; x += 32) {
+        f = vld1q_u8(front);
+        b = vld1q_u8(back - 16);
+        vst1q_u8(front, reverse_16_neon(b));
+        vst1q_u8(back - 16, reverse_16_neon(f));
+        front += 16;
+        back -= 16;
     }
+    return x;
 }
 
-void cls_rotate::rot90ccw(u_char *src, u_char *dst, int size, int width, int height)
+#endif
+
+/* Reverse n bytes in place */
+void cls_rotate::reverse(u_char *src, int n)
 {
-    u_char *endp;
-    u_char *base;
-    int j;
+    int x = 0;
 
-    endp = src + size;
-    dst = dst + size - 1;
-    for (base = endp - width; base < endp; base++) {
-        src = base;
-        for (j = 0; j < height; j++, src -= width)
-            *dst-- = *src;
+    #if defined(__x86_64__) || defined(__i386__)
+        if (simd) {
+            x = reverse_sse2(src, src + n, n);
+        }
+    #elif defined(__ARM_NEON)
+        if (simd) {
+            x = reverse_neon(src, src + n, n);
+        }
+    #endif
+    reverse_c(src + (x / 2), src + n - (x / 2), x, n);
+}
 
+void cls_rotate::turn_8x8(const u_char **rows, int x0, u_char *dst, int dst_w, bool rev)
+{
+    #if defined(__x86_64__) || defined(__i386__)
+        if (simd) {
+            turn_8x8_sse2(rows, x0, dst, dst_w, rev);
+            return;
+        }
+    #elif defined(__ARM_NEON)
+        if (simd) {
+            turn_8x8_neon(rows, x0, dst, dst_w, rev);
+            return;
+        }
+    #endif
+    turn_8x8_c(rows, x0, dst, dst_w, rev);
+}
+
+/*
+ * Mirror a plane in place.  mirror_y swaps the rows top to bottom and
+ * mirror_x reverses each row.  Both together reverse the whole plane.
+ */
+void cls_rotate::mirror_plane(u_char *img, int width, int height
+    , bool mirror_x, bool mirror_y)
+{
+    u_char *top, *bottom;
+    int row;
+
+    if (mirror_x && mirror_y) {
+        reverse(img, width * height);
+    } else if (mirror_y) {
+        top = img;
+        bottom = img + ((height - 1) * width);
+        for (row = 0; row < (height / 2); row++) {
+            memcpy(buffer_row, top, (uint)width);
+            memcpy(top, bottom, (uint)width);
+            memcpy(bottom, buffer_row, (uint)width);
+            top += width;
+            bottom -= width;
+        }
+    } else if (mirror_x) {
+        for (row = 0; row < height; row++) {
+            reverse(img + (row * width), width);
+        }
+    }
+}
+
+/*
+ * Transpose a plane of width x height into dst, which is height wide
+ * and width high:  dst[r][c] = src[y][x] where y is c, or height-1-c
+ * when mirror_y, and x is r, or width-1-r when mirror_x.
+ */
+void cls_rotate::turn_plane(u_char *src, u_char *dst, int width, int height
+    , bool mirror_x, bool mirror_y)
+{
+    const u_char *rows[8];
+    int ty, tx, c0, r0, c, r, cn, rn, x0;
+
+    for (ty = 0; ty < height; ty += ROTATE_TILE) {
+        for (tx = 0; tx < width; tx += ROTATE_TILE) {
+            for (c0 = ty; c0 < MIN(ty + ROTATE_TILE, height); c0 += 8) {
+                cn = MIN(8, height - c0);
+                for (c = 0; c < cn; c++) {
+                    rows[c] = src + ((mirror_y ? (height - 1 - (c0 + c)) : (c0 + c)) * width);
+                }
+                for (r0 = tx; r0 < MIN(tx + ROTATE_TILE, width); r0 += 8) {
+                    rn = MIN(8, width - r0);
+                    if ((cn == 8) && (rn == 8)) {
+                        x0 = mirror_x ? (width - 8 - r0) : r0;
+                        turn_8x8(rows, x0, dst + (r0 * height) + c0, height, mirror_x);
+                        continue;
+                    }
+                    for (r = 0; r < rn; r++) {
+                        x0 = mirror_x ? (width - 1 - (r0 + r)) : (r0 + r);
+                        for (c = 0; c < cn; c++) {
+                            dst[((r0 + r) * height) + c0 + c] = rows[c][x0];
+                        }
+                    }
+                }
+            }
+        }
     }
 }
 
@@ -134,8 +330,7 @@ void cls_rotate::process(ctx_image_data *img_data)
      */
 
     int indx, indx_max;
-    int wh, wh4 = 0, w2 = 0, h2 = 0;  /* width * height, width * height / 4 etc. */
-    int size;
+    int wh, wh4, w2, h2;  /* width * height, width * height / 4 etc. */
     int width, height;
     u_char *img;
     u_char *temp_buff;
@@ -163,57 +358,22 @@ void cls_rotate::process(ctx_image_data *img_data)
             height = capture_height_high;
             temp_buff = buffer_high;
         }
-        /*
-         * Pre-calculate some stuff:
-         *  wh   - size of the Y plane
-         *  size - size of the entire memory block
-         *  wh4  - size of the U plane, and the V plane
-         *  w2   - width of the U plane, and the V plane
-         *  h2   - as w2, but height instead
-         */
         wh = width * height;
-        size = wh * 3 / 2;
         wh4 = wh / 4;
         w2 = width / 2;
         h2 = height / 2;
 
-        switch (axis) {
-        case FLIP_TYPE_HORIZONTAL:
-            flip_inplace_horizontal(img,width, height);
-            flip_inplace_horizontal(img + wh, w2, h2);
-            flip_inplace_horizontal(img + wh + wh4, w2, h2);
-            break;
-        case FLIP_TYPE_VERTICAL:
-            flip_inplace_vertical(img,width, height);
-            flip_inplace_vertical(img + wh, w2, h2);
-            flip_inplace_vertical(img + wh + wh4, w2, h2);
-            break;
-        default:
-            break;
-        }
-
-        switch (degrees) {
-        case 90:
-            rot90cw(img, temp_buff, wh, width, height);
-            rot90cw(img + wh, temp_buff + wh, wh4, w2, h2);
-            rot90cw(img + wh + wh4, temp_buff + wh + wh4, wh4, w2, h2);
-            memcpy(img, temp_buff, (uint)size);
-            break;
-        case 180:
-            reverse_inplace_quad(img, wh);
-            reverse_inplace_quad(img + wh, wh4);
-            reverse_inplace_quad(img + wh + wh4, wh4);
-            break;
-        case 270:
-            rot90ccw(img, temp_buff, wh, width, height);
-            rot90ccw(img + wh, temp_buff + wh, wh4, w2, h2);
-            rot90ccw(img + wh + wh4, temp_buff + wh + wh4, wh4, w2, h2);
-            memcpy(img, temp_buff, (uint)size);
-            break;
-        default:
-            break;
+        if ((degrees == 90) || (degrees == 270)) {
+            turn_plane(img, temp_buff, width, height, mirror_x, mirror_y);
+            turn_plane(img + wh, temp_buff + wh, w2, h2, mirror_x, mirror_y);
+            turn_plane(img + wh + wh4, temp_buff + wh + wh4, w2, h2, mirror_x, mirror_y);
+            memcpy(img, temp_buff, (uint)(wh + (2 * wh4)));
+        } else {
+            mirror_plane(img, width, height, mirror_x, mirror_y);
+            mirror_plane(img + wh, w2, h2, mirror_x, mirror_y);
+            mirror_plane(img + wh + wh4, w2, h2, mirror_x, mirror_y);
         }
-            indx++;
+        indx++;
     }
 
     return;
@@ -226,6 +386,8 @@ cls_rotate::cls_rotate(cls_camera *p_cam)
 
     buffer_norm = nullptr;
     buffer_high = nullptr;
+    buffer_row = nullptr;
+    simd = false;
 
     if ((cam->cfg->rotate % 90) > 0) {
         MOTION_LOG(WRN, TYPE_ALL, NO_ERRNO
@@ -269,7 +431,27 @@ cls_rotate::cls_rotate(cls_camera *p_cam)
         }
     }
 
-    if (degrees == 0) {
+    /*
+     * Fold the flip into the rotation.  90 degrees reads the source rows
+     * bottom up, 270 reads the columns right to left and 180 does both.
+     * Flipping horizontal swaps the rows and vertical the columns.
+     */
+    mirror_y = ((degrees == 90) || (degrees == 180));
+    mirror_x = ((degrees == 180) || (degrees == 270));
+    if (axis == FLIP_TYPE_HORIZONTAL) {
+        mirror_y = !mirror_y;
+    } else if (axis == FLIP_TYPE_VERTICAL) {
+        mirror_x = !mirror_x;
+    }
+
+    #if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        simd = __builtin_cpu_supports("sse2");
+    #elif defined(__ARM_NEON)
+        simd = true;
+    #endif
+
+    if ((degrees == 0) && (axis == FLIP_TYPE_NONE)) {
         return;
     }
 
@@ -278,6 +460,8 @@ cls_rotate::cls_rotate(cls_camera *p_cam)
         if (size_high > 0 ) {
             buffer_high =(u_char*) mymalloc((uint)size_high);
         }
+    } else {
+        buffer_row =(u_char*) mymalloc((uint)MAX(capture_width_norm, capture_width_high));
     }
 
 }
@@ -286,5 +470,6 @@ cls_rotate::~cls_rotate()
 {
     myfree(buffer_norm);
     myfree(buffer_high);
+    myfree(buffer_row);
 
 }
@@ -36,8 +36,12 @@ class cls_rotate {
 
         u_char *buffer_norm; /* Temp low res buffer for 90 and 270 degrees rotation */
         u_char *buffer_high; /* Temp high res buffer for 90 and 270 degrees rotation */
+        u_char *buffer_row;  /* Temp row for flipping 0 and 180 degrees images */
         int degrees;                /* Degrees to rotate;  */
         enum FLIP_TYPE axis;        /* Rotate image over the Horizontal or Vertical axis. */
+        bool mirror_x;              /* Read the source columns right to left */
+        bool mirror_y;              /* Read the source rows bottom to top */
+        bool simd;                  /* Use the SSE2 or NEON kernels */
 
         int capture_width_norm;     /* Capture width of normal resolution image */
         int capture_height_norm;    /* Capture height of normal resolution image */
@@ -45,11 +49,11 @@ class cls_rotate {
         int capture_width_high;     /* Capture width of high resolution image */
         int capture_height_high;    /* Capture height of high resolution image */
 
-        void reverse_inplace_quad(u_char *src, int size);
-        void flip_inplace_horizontal(u_char *src, int width, int height);
-        void flip_inplace_vertical(u_char *src, int width, int height);
-        void rot90cw(u_char *src, u_char *dst, int size, int width, int height);
-        void rot90ccw(u_char *src, u_char *dst, int size, int width, int height);
+        void reverse(u_char *src, int n);
+        void turn_8x8(const u_char **rows, int x0, u_char *dst, int dst_w, bool rev);
+        void mirror_plane(u_char *img, int width, int height, bool mirror_x, bool mirror_y);
+        void turn_plane(u_char *src, u_char *dst, int width, int height
+            , bool mirror_x, bool mirror_y);
 
 
 };
@@ -24,7 +24,11 @@
 #include "camera.hpp"
 #include "netcam.hpp"
 #include "dbse.hpp"
+#include "storage.hpp"
+#include "evwait.hpp"
 #include "schedule.hpp"
+#include <set>
+#include <sys/statvfs.h>
 
 static void *schedule_handler(void *arg)
 {
@@ -32,6 +36,12 @@ static void *schedule_handler(void *arg)
     return nullptr;
 }
 
+static void *schedule_cleandir_worker(void *arg)
+{
+    ((cls_schedule *)arg)->cleandir_worker();
+    return nullptr;
+}
+
 void cls_schedule::schedule_cam(cls_camera *p_cam)
 {
     int indx, cur_dy;
@@ -117,30 +127,265 @@ void cls_schedule::cleandir_remove_dir(std::string dirnm)
     }
 }
 
-void cls_schedule::cleandir_remove(std::string sql, bool removedir)
+/* Worker thread that removes files from clean_lst until it is exhausted */
+void cls_schedule::cleandir_worker()
 {
-    vec_files flst;
-    struct stat statbuf;
-    int indx;
+    ctx_file_item itm;
+    bool removed;
 
-    app->dbse->filelist_get(sql, flst);
+    mythreadname_set("sc", 0, "cleandir");
 
-    for (indx=0;indx<flst.size();indx++) {
-        if (stat(flst[indx].full_nm.c_str(), &statbuf) == 0) {
-            MOTION_LOG(DBG, TYPE_ALL, NO_ERRNO
-                , _("Removing %s"),flst[indx].full_nm.c_str());
-            remove(flst[indx].full_nm.c_str());
-            sql  = " delete from motion ";
-            sql += " where record_id  = ";
-            sql += std::to_string(flst[indx].record_id);
-            app->dbse->exec_sql(sql);
+    while (true) {
+        pthread_mutex_lock(&mutex_clean);
+            if ((clean_indx >= clean_lst.size()) ||
+                (restart == true) || (handler_stop == true)) {
+                pthread_mutex_unlock(&mutex_clean);
+                break;
+            }
+            itm = clean_lst[clean_indx];
+            clean_indx++;
+        pthread_mutex_unlock(&mutex_clean);
+
+        /* Event rows refer to part of a segment so never remove the file */
+        if (itm.file_typ == "event") {
+            continue;
         }
-        if (removedir == true) {
-            cleandir_remove_dir(flst[indx].file_dir);
+
+        MOTION_LOG(DBG, TYPE_ALL, NO_ERRNO
+            , _("Removing %s"),itm.full_nm.c_str());
+        if (remove(itm.full_nm.c_str()) == 0) {
+            removed = true;
+        } else if (errno == ENOENT) {
+            removed = true;
+        } else {
+            MOTION_LOG(WRN, TYPE_ALL, SHOW_ERRNO
+                , _("Unable to remove %s"),itm.full_nm.c_str());
+            removed = false;
+        }
+
+        if (removed) {
+            pthread_mutex_lock(&mutex_clean);
+                clean_ids.push_back(itm.record_id);
+                clean_nms.push_back(itm.full_nm);
+                clean_cnt++;
+                clean_bytes += itm.file_sz;
+            pthread_mutex_unlock(&mutex_clean);
+        }
+        if (clean_rmdir == true) {
+            cleandir_remove_dir(itm.file_dir);
+        }
+        if ((clean_wait.tv_sec != 0) || (clean_wait.tv_nsec != 0)) {
+            SLEEP(clean_wait.tv_sec, clean_wait.tv_nsec);
+        }
+    }
+}
+
+/*
+ * Remove the files in batches.  Each batch is spread across the
+ * workers and the records for the files removed are then deleted
+ * from the database in a single transaction.
+ */
+void cls_schedule::cleandir_remove(ctx_cleandir *p_clean, vec_files &flst)
+{
+    std::vector<pthread_t> workers;
+    pthread_t wrk;
+    size_t st, en;
+    int indx;
+    int64_t wait_ns;
+
+    clean_cnt = 0;
+    clean_bytes = 0;
+    clean_rmdir = p_clean->removedir;
+    if (p_clean->rate > 0) {
+        wait_ns = ((int64_t)p_clean->threads * 1000000000L) / p_clean->rate;
+    } else {
+        wait_ns = 0;
+    }
+    clean_wait.tv_sec = (time_t)(wait_ns / 1000000000L);
+    clean_wait.tv_nsec = (long)(wait_ns % 1000000000L);
+
+    for (st=0; st<flst.size(); st+=(size_t)p_clean->batch) {
+        en = MIN(st + (size_t)p_clean->batch, flst.size());
+
+        pthread_mutex_lock(&mutex_clean);
+            clean_lst.assign(flst.begin() + (long)st, flst.begin() + (long)en);
+            clean_indx = 0;
+            clean_ids.clear();
+            clean_nms.clear();
+        pthread_mutex_unlock(&mutex_clean);
+
+        workers.clear();
+        for (indx=0; indx<p_clean->threads; indx++) {
+            if (pthread_create(&wrk, nullptr
+                    , &schedule_cleandir_worker, this) == 0) {
+                workers.push_back(wrk);
+            }
         }
+        if (workers.size() == 0) {
+            MOTION_LOG(WRN, TYPE_ALL, NO_ERRNO
+                ,_("Unable to start clean directory workers."));
+            cleandir_worker();
+        }
+        for (indx=0; indx<(int)workers.size(); indx++) {
+            pthread_join(workers[(size_t)indx], nullptr);
+        }
+
+        app->dbse->filelist_del(clean_ids, clean_nms);
+
         if ((restart == true) || (handler_stop == true)) {
-            return;
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&mutex_clean);
+        clean_lst.clear();
+        clean_ids.clear();
+        clean_nms.clear();
+    pthread_mutex_unlock(&mutex_clean);
+}
+
+/* Bytes that must be freed to bring the target_dir under max_pct */
+int64_t cls_schedule::cleandir_pct_need(cls_camera *p_cam)
+{
+    struct statvfs fs;
+    int64_t fs_total, fs_used;
+
+    if (p_cam->cleandir->max_pct == 0) {
+        return 0;
+    }
+    if (statvfs(p_cam->cfg->target_dir.c_str(), &fs) != 0) {
+        return 0;
+    }
+    fs_total = (int64_t)fs.f_blocks * (int64_t)fs.f_frsize;
+    fs_used  = (int64_t)(fs.f_blocks - fs.f_bfree) * (int64_t)fs.f_frsize;
+
+    return fs_used - ((fs_total / 100) * p_cam->cleandir->max_pct);
+}
+
+/*
+ * Add the oldest files of the camera that are not already in flst
+ * until their sizes account for the bytes needed.  Returns the
+ * bytes that could not be accounted for.
+ */
+int64_t cls_schedule::cleandir_oldest(cls_camera *p_cam, vec_files &flst, int64_t need)
+{
+    vec_files allfiles;
+    std::set<int64_t> picked;
+    std::string sql;
+    size_t indx;
+
+    sql  = " select * from motion ";
+    sql += " where device_id = ";
+    sql += std::to_string(p_cam->cfg->device_id);
+    sql += " and (file_typ is null or file_typ <> 'event') ";
+    sql += " order by file_dtl, file_tml;";
+    app->dbse->filelist_get(sql, allfiles);
+
+    for (indx=0; indx<flst.size(); indx++) {
+        picked.insert(flst[indx].record_id);
+    }
+
+    for (indx=0; (indx<allfiles.size()) && (need > 0); indx++) {
+        if (picked.count(allfiles[indx].record_id) == 0) {
+            flst.push_back(allfiles[indx]);
+            need -= allfiles[indx].file_sz;
+        }
+    }
+
+    return need;
+}
+
+/*
+ * Add the oldest files of the camera to flst until the size budget
+ * (max_size) and the filesystem budget (max_pct) are both satisfied.
+ */
+void cls_schedule::cleandir_budget(cls_camera *p_cam, vec_files &flst)
+{
+    vec_files allfiles;
+    std::string sql;
+    int64_t need, tot_sz;
+    size_t indx;
+
+    if ((p_cam->cleandir->max_size == 0) &&
+        (p_cam->cleandir->max_pct == 0)) {
+        return;
+    }
+
+    need = 0;
+    if (p_cam->cleandir->max_size > 0) {
+        sql  = " select * from motion ";
+        sql += " where device_id = ";
+        sql += std::to_string(p_cam->cfg->device_id);
+        sql += " and (file_typ is null or file_typ <> 'event') ";
+        sql += " order by file_dtl, file_tml;";
+        app->dbse->filelist_get(sql, allfiles);
+        tot_sz = 0;
+        for (indx=0; indx<allfiles.size(); indx++) {
+            tot_sz += allfiles[indx].file_sz;
         }
+        need = tot_sz - ((int64_t)p_cam->cleandir->max_size * 1024 * 1024);
+    }
+    need = MAX(need, cleandir_pct_need(p_cam));
+
+    for (indx=0; indx<flst.size(); indx++) {
+        need -= flst[indx].file_sz;
+    }
+
+    if (need <= 0) {
+        return;
+    }
+
+    /* Warn when the budget is first missed and then once an hour */
+    if (cleandir_oldest(p_cam, flst, need) > 0) {
+        if ((time(NULL) - p_cam->cleandir->warn_ts) >= (60 * 60)) {
+            MOTION_LOG(WRN, TYPE_ALL, NO_ERRNO
+                , _("Clean directory budget can not be met for camera %d.")
+                , p_cam->cfg->device_id);
+            p_cam->cleandir->warn_ts = time(NULL);
+        }
+    } else {
+        p_cam->cleandir->warn_ts = 0;
+    }
+}
+
+/* Evict the oldest files when the storage manager forecasts a shortfall */
+void cls_schedule::storage_cam(cls_camera *p_cam)
+{
+    ctx_cleandir dflt;
+    vec_files flst;
+    int64_t need;
+
+    if ((restart == true) ||
+        (handler_stop == true) ||
+        (p_cam == nullptr) ||
+        (p_cam->storage == nullptr)) {
+        return;
+    }
+
+    p_cam->storage->update();
+    need = p_cam->storage->evict_need();
+    if (need <= 0) {
+        return;
+    }
+
+    cleandir_oldest(p_cam, flst, need);
+    if (flst.size() == 0) {
+        return;
+    }
+
+    if (p_cam->cleandir != nullptr) {
+        cleandir_remove(p_cam->cleandir, flst);
+    } else {
+        dflt.removedir = false;
+        dflt.threads = 2;
+        dflt.rate = 50;
+        dflt.batch = 250;
+        cleandir_remove(&dflt, flst);
+    }
+
+    /* Only the files actually removed count towards the forecast */
+    if (clean_cnt > 0) {
+        p_cam->storage->evicted(clean_cnt, clean_bytes);
     }
 }
 
@@ -163,6 +408,7 @@ void cls_schedule::cleandir_sql(int device_id, std::string &sql, struct timespec
     sql += " from motion ";
     sql += " where ";
     sql += " device_id = " + std::to_string(device_id);
+    sql += " and (file_typ is null or file_typ <> 'event') ";
     sql += " and ((file_dtl < " + tmp_dtl + ") ";
     sql += "   or ((file_dtl = " + tmp_dtl + ") ";
     sql += "   and (file_tml < '" + tmp_tml + "'))) ";
@@ -176,6 +422,7 @@ void cls_schedule::cleandir_run(cls_camera *p_cam)
     struct timespec test_ts;
     int64_t cdur;
     std::string sql;
+    vec_files flst;
 
     if ((restart == true) || (handler_stop == true)) {
         return;
@@ -205,7 +452,9 @@ void cls_schedule::cleandir_run(cls_camera *p_cam)
     test_ts.tv_sec -= cdur;
 
     cleandir_sql(p_cam->cfg->device_id, sql, test_ts);
-    cleandir_remove(sql, p_cam->cleandir->removedir);
+    app->dbse->filelist_get(sql, flst);
+    cleandir_budget(p_cam, flst);
+    cleandir_remove(p_cam->cleandir, flst);
 
 }
 
@@ -213,6 +462,7 @@ void cls_schedule::cleandir_cam(cls_camera *p_cam)
 {
     struct tm c_tm;
     struct timespec curr_ts;
+    vec_files flst;
 
     if ((restart == true) ||
         (handler_stop == true) ||
@@ -255,18 +505,36 @@ void cls_schedule::cleandir_cam(cls_camera *p_cam)
                 ,c_tm.tm_year+1900,c_tm.tm_mon+1,c_tm.tm_mday
                 ,c_tm.tm_hour,c_tm.tm_min);
         }
+    } else if ((p_cam->cleandir->action == "delete") &&
+               (curr_ts.tv_sec >= p_cam->cleandir->pct_retry) &&
+               (cleandir_pct_need(p_cam) > 0)) {
+        /*
+         * Filesystem over budget between scheduled runs.  When a pass
+         * frees nothing (e.g. the space is used by other files) wait
+         * an hour before trying again.
+         */
+        cleandir_budget(p_cam, flst);
+        cleandir_remove(p_cam->cleandir, flst);
+        if (clean_cnt == 0) {
+            p_cam->cleandir->pct_retry = curr_ts.tv_sec + (60 * 60);
+        } else {
+            p_cam->cleandir->pct_retry = 0;
+        }
     }
 }
 
+/* Ask the schedule process to run a pass now instead of at the next interval */
+void cls_schedule::wake()
+{
+    evwait->wake();
+}
+
 void cls_schedule::timing()
 {
-    int indx;
-    for (indx=0; indx<30; indx++) {
-        if ((restart == true) || (handler_stop == true)) {
-            return;
-        }
-        SLEEP(1, 0);
+    if ((restart == true) || (handler_stop == true)) {
+        return;
     }
+    evwait->wait_for(30, 0);
 }
 
 void cls_schedule::handler()
@@ -282,6 +550,9 @@ void cls_schedule::handler()
         for (indx=0; indx<app->cam_cnt; indx++) {
             cleandir_cam(app->cam_list[indx]);
         }
+        for (indx=0; indx<app->cam_cnt; indx++) {
+            storage_cam(app->cam_list[indx]);
+        }
         timing();
     }
 
@@ -317,6 +588,7 @@ void cls_schedule::handler_shutdown()
 
     if (handler_running == true) {
         handler_stop = true;
+        evwait->wake();
         waitcnt = 0;
         while ((handler_running == true) && (waitcnt < app->cfg->watchdog_tmo)){
             SLEEP(1,0)
@@ -360,6 +632,14 @@ cls_schedule::cls_schedule(cls_motapp *p_app)
     handler_stop = true;
     finish = false;
     watchdog = app->cfg->watchdog_tmo;
+    clean_indx = 0;
+    clean_rmdir = false;
+    clean_cnt = 0;
+    clean_bytes = 0;
+    clean_wait.tv_sec = 0;
+    clean_wait.tv_nsec = 0;
+    pthread_mutex_init(&mutex_clean, nullptr);
+    evwait = new cls_evwait();
 
     handler_startup();
 }
@@ -368,4 +648,6 @@ cls_schedule::~cls_schedule()
 {
     finish = true;
     handler_shutdown();
+    pthread_mutex_destroy(&mutex_clean);
+    mydelete(evwait);
 }
@@ -32,19 +32,37 @@ class cls_schedule {
         bool    restart;
         bool    finish;
 
+        void    cleandir_worker();
+        void    wake();
+
     private:
         cls_motapp          *app;
 
         int watchdog;
+        cls_evwait          *evwait;
+
+        pthread_mutex_t     mutex_clean;    /* Protects the clean_ work list below */
+        vec_files           clean_lst;      /* Files assigned to the current batch */
+        size_t              clean_indx;     /* Next item in clean_lst for a worker */
+        std::vector<int64_t> clean_ids;     /* Record ids of files removed */
+        std::vector<std::string> clean_nms; /* Full names of files removed */
+        int                 clean_cnt;      /* Files removed by the last cleandir_remove */
+        int64_t             clean_bytes;    /* Bytes of the files removed */
+        bool                clean_rmdir;
+        struct timespec     clean_wait;     /* Pause per worker between removals */
 
         void handler_startup();
         void handler_shutdown();
         void timing();
         void cleandir_cam(cls_camera *p_cam);
         void cleandir_run(cls_camera *p_cam);
-        void cleandir_remove(std::string sql, bool removedir);
+        void cleandir_remove(ctx_cleandir *p_clean, vec_files &flst);
         void cleandir_remove_dir(std::string dirnm);
         void cleandir_sql(int device_id, std::string &sql, struct timespec ts);
+        int64_t cleandir_pct_need(cls_camera *p_cam);
+        void cleandir_budget(cls_camera *p_cam, vec_files &flst);
+        int64_t cleandir_oldest(cls_camera *p_cam, vec_files &flst, int64_t need);
+        void storage_cam(cls_camera *p_cam);
         void schedule_cam(cls_camera *p_cam);
 
 };
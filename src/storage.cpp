@@ -0,0 +1,226 @@
+/*
+ *    This file is part of Motion.
+ *
+ *    Motion is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Motion is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Motion.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "motion.hpp"
+#include "util.hpp"
+#include "camera.hpp"
+#include "conf.hpp"
+#include "logger.hpp"
+#include "dbse.hpp"
+#include "storage.hpp"
+#include "schedule.hpp"
+#include <sys/statvfs.h>
+
+void cls_storage::init()
+{
+    int indx;
+    ctx_params  *params;
+    std::string  pnm, pvl;
+
+    pthread_mutex_lock(&mutex_storage);
+        enabled = false;
+        evict = true;
+        reserve = 0;
+        horizon = 900;
+    pthread_mutex_unlock(&mutex_storage);
+
+    if (cam->cfg->storage_params == "") {
+        return;
+    }
+
+    params = new ctx_params;
+    util_parms_parse(params, "storage_params", cam->cfg->storage_params);
+
+    pthread_mutex_lock(&mutex_storage);
+        enabled = true;
+        for (indx=0; indx<params->params_cnt; indx++) {
+            pnm = params->params_array[indx].param_name;
+            pvl = params->params_array[indx].param_value;
+            if (pnm == "reserve") {
+                reserve = mtoi(pvl);
+            }
+            if (pnm == "horizon") {
+                horizon = mtoi(pvl);
+            }
+            if (pnm == "evict") {
+                evict = mtob(pvl);
+            }
+        }
+        if (reserve < 0) {
+            MOTION_LOG(ERR, TYPE_ALL, NO_ERRNO
+                ,_("Invalid storage reserve : %d"), reserve);
+            reserve = 0;
+        }
+        if ((horizon < 0) || (horizon > 86400)) {
+            MOTION_LOG(ERR, TYPE_ALL, NO_ERRNO
+                ,_("Invalid storage horizon : %d"), horizon);
+            horizon = 900;
+        }
+    pthread_mutex_unlock(&mutex_storage);
+
+    mydelete(params);
+
+    MOTION_LOG(INF, TYPE_ALL, NO_ERRNO
+        , _("Storage manager reserve:%dMB horizon:%ds evict:%s")
+        , reserve, horizon, evict ? "Y":"N");
+}
+
+/* Caller must hold mutex_storage */
+void cls_storage::fs_check()
+{
+    struct statvfs fs;
+
+    if (statvfs(cam->cfg->target_dir.c_str(), &fs) != 0) {
+        return;
+    }
+    fs_total = (int64_t)fs.f_blocks * (int64_t)fs.f_frsize;
+    fs_free  = (int64_t)fs.f_bavail * (int64_t)fs.f_frsize;
+}
+
+/* Record the size of a picture or movie once it is closed */
+void cls_storage::file_saved(std::string fullnm, bool is_movie)
+{
+    struct stat statbuf;
+
+    if (stat(fullnm.c_str(), &statbuf) != 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&mutex_storage);
+        bytes_total += statbuf.st_size;
+        if (is_movie && (statbuf.st_size > bytes_movie_max)) {
+            bytes_movie_max = statbuf.st_size;
+        }
+    pthread_mutex_unlock(&mutex_storage);
+}
+
+/* Check for headroom before a movie starts */
+void cls_storage::movie_check()
+{
+    bool wake;
+
+    pthread_mutex_lock(&mutex_storage);
+        if (enabled == false) {
+            pthread_mutex_unlock(&mutex_storage);
+            return;
+        }
+        fs_check();
+        if (fs_free < bytes_movie_max) {
+            MOTION_LOG(WRN, TYPE_EVENTS, NO_ERRNO
+                , _("Free space %" PRId64 "MB is less than the largest movie %" PRId64 "MB")
+                , fs_free / (1024 * 1024), bytes_movie_max / (1024 * 1024));
+            evict_now = true;
+        }
+        wake = evict_now;
+    pthread_mutex_unlock(&mutex_storage);
+
+    /* Evict now rather than at the next scheduled pass */
+    if ((wake == true) && (cam->app->schedule != nullptr)) {
+        cam->app->schedule->wake();
+    }
+}
+
+/*
+ * Update the forecast.  The write rate is smoothed so that a single
+ * event does not swing the headroom and the headroom covers both the
+ * largest movie seen and the bytes expected over the horizon.
+ */
+void cls_storage::update()
+{
+    struct timespec curr_ts;
+    int64_t elapsed, inst_bps;
+
+    clock_gettime(CLOCK_MONOTONIC, &curr_ts);
+
+    pthread_mutex_lock(&mutex_storage);
+        elapsed = curr_ts.tv_sec - update_ts.tv_sec;
+        if (elapsed > 0) {
+            inst_bps = (bytes_total - bytes_prev) / elapsed;
+            if (rate_bps == 0) {
+                rate_bps = inst_bps;
+            } else {
+                rate_bps = ((rate_bps * 7) + inst_bps) / 8;
+            }
+            bytes_prev = bytes_total;
+            update_ts = curr_ts;
+        }
+        fs_check();
+        headroom = ((int64_t)reserve * 1024 * 1024) +
+            MAX(bytes_movie_max, rate_bps * horizon);
+    pthread_mutex_unlock(&mutex_storage);
+}
+
+/* Bytes that must be evicted to restore the headroom */
+int64_t cls_storage::evict_need()
+{
+    int64_t need;
+
+    pthread_mutex_lock(&mutex_storage);
+        if ((enabled == false) || (evict == false)) {
+            need = 0;
+        } else {
+            need = headroom - fs_free;
+            if ((need <= 0) && (evict_now == true) && (fs_free < bytes_movie_max)) {
+                need = bytes_movie_max - fs_free;
+            }
+        }
+        evict_now = false;
+    pthread_mutex_unlock(&mutex_storage);
+
+    return need;
+}
+
+void cls_storage::evicted(int filecnt, int64_t bytes)
+{
+    pthread_mutex_lock(&mutex_storage);
+        evict_files += filecnt;
+        evict_bytes += bytes;
+        fs_check();
+    pthread_mutex_unlock(&mutex_storage);
+
+    MOTION_LOG(NTC, TYPE_ALL, NO_ERRNO
+        , _("Storage manager evicted %d files %" PRId64 "MB")
+        , filecnt, bytes / (1024 * 1024));
+}
+
+cls_storage::cls_storage(cls_camera *p_cam)
+{
+    cam = p_cam;
+
+    pthread_mutex_init(&mutex_storage, nullptr);
+    enabled = false;
+    evict = true;
+    reserve = 0;
+    horizon = 900;
+    bytes_total = 0;
+    bytes_movie_max = 0;
+    rate_bps = 0;
+    fs_total = 0;
+    fs_free = 0;
+    headroom = 0;
+    evict_bytes = 0;
+    evict_files = 0;
+    evict_now = false;
+    bytes_prev = 0;
+    clock_gettime(CLOCK_MONOTONIC, &update_ts);
+}
+
+cls_storage::~cls_storage()
+{
+    pthread_mutex_destroy(&mutex_storage);
+}
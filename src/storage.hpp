@@ -0,0 +1,63 @@
+/*
+ *    This file is part of Motion.
+ *
+ *    Motion is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    Motion is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with Motion.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _INCLUDE_STORAGE_HPP_
+#define _INCLUDE_STORAGE_HPP_
+
+/*
+ * Tracks the bytes written by a camera and forecasts how much free
+ * space must be kept in the target_dir so the next event can be
+ * written completely.  The schedule process evicts the oldest files
+ * of the camera when the free space falls below that headroom.
+ */
+class cls_storage {
+    public:
+        cls_storage(cls_camera *p_cam);
+        ~cls_storage();
+
+        void init();
+        void file_saved(std::string fullnm, bool is_movie);
+        void movie_check();
+        void update();
+        void evicted(int filecnt, int64_t bytes);
+        int64_t evict_need();
+
+        pthread_mutex_t mutex_storage;
+        bool        enabled;
+        bool        evict;          /* Whether files may be evicted */
+        int         reserve;        /* Megabytes always kept free */
+        int         horizon;        /* Seconds of recording to keep free */
+        int64_t     bytes_total;    /* Bytes written since startup */
+        int64_t     bytes_movie_max;/* Largest movie written */
+        int64_t     rate_bps;       /* Forecast bytes written per second */
+        int64_t     fs_total;
+        int64_t     fs_free;
+        int64_t     headroom;       /* Bytes that should be free */
+        int64_t     evict_bytes;    /* Bytes removed by eviction */
+        int         evict_files;    /* Files removed by eviction */
+        bool        evict_now;      /* Request eviction on next schedule pass */
+
+    private:
+        cls_camera  *cam;
+        int64_t     bytes_prev;
+        struct timespec update_ts;
+
+        void fs_check();
+};
+
+#endif /* _INCLUDE_STORAGE_HPP_ */
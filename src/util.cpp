@@ -149,6 +149,22 @@ void *mymalloc(size_t nbytes)
     return dummy;
 }
 
+/* Page aligned and zeroed memory that is released with free() */
+void *mymalloc_page(size_t nbytes)
+{
+    void *dummy = NULL;
+
+    if (posix_memalign(&dummy, (size_t)sysconf(_SC_PAGESIZE), nbytes) != 0) {
+        MOTION_LOG(EMG, TYPE_ALL, SHOW_ERRNO
+            , _("Could not allocate %llu bytes of memory!")
+            , (unsigned long long)nbytes);
+        exit(1);
+    }
+    memset(dummy, 0, nbytes);
+
+    return dummy;
+}
+
 /** myrealloc */
 void *myrealloc(void *ptr, size_t size, const char *desc)
 {
@@ -716,6 +732,59 @@ AVPacket *mypacket_alloc(AVPacket *pkt)
 
 }
 
+/*********************************************/
+/* Attach the boxes (in src_w x src_h pixels) as regions of interest.
+ * The boxes get a lower quantizer by strength percent and the rest of
+ * the frame a higher one by half of that.  Regions of interest are not
+ * in versions before 4.2 so nothing is attached.
+ */
+void myframe_roi(AVFrame *frame, std::vector<ctx_coord> &boxes
+    , int src_w, int src_h, int strength)
+{
+    #if (MYFFVER < 58029)
+        (void)frame;
+        (void)boxes;
+        (void)src_w;
+        (void)src_h;
+        (void)strength;
+    #else
+        AVFrameSideData *sd;
+        AVRegionOfInterest *roi;
+        size_t indx, cnt;
+
+        av_frame_remove_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST);
+
+        if ((strength <= 0) || (boxes.empty() == true) ||
+            (src_w <= 0) || (src_h <= 0)) {
+            return;
+        }
+
+        cnt = boxes.size() + 1;
+        sd = av_frame_new_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST
+            , sizeof(AVRegionOfInterest) * cnt);
+        if (sd == NULL) {
+            return;
+        }
+
+        /* The first region in the array wins where they overlap */
+        roi = (AVRegionOfInterest *)sd->data;
+        for (indx=0; indx<boxes.size(); indx++) {
+            roi[indx].self_size = sizeof(AVRegionOfInterest);
+            roi[indx].left   = (boxes[indx].minx * frame->width) / src_w;
+            roi[indx].right  = ((boxes[indx].maxx + 1) * frame->width) / src_w;
+            roi[indx].top    = (boxes[indx].miny * frame->height) / src_h;
+            roi[indx].bottom = ((boxes[indx].maxy + 1) * frame->height) / src_h;
+            roi[indx].qoffset = av_make_q(-strength, 100);
+        }
+        roi[cnt-1].self_size = sizeof(AVRegionOfInterest);
+        roi[cnt-1].left   = 0;
+        roi[cnt-1].right  = frame->width;
+        roi[cnt-1].top    = 0;
+        roi[cnt-1].bottom = frame->height;
+        roi[cnt-1].qoffset = av_make_q(strength, 200);
+    #endif
+}
+
 void util_exec_command(cls_camera *cam, const char *command, const char *filename)
 {
     char stamp[PATH_MAX];
@@ -62,6 +62,7 @@ struct ctx_params {
 };
 
     void *mymalloc(size_t nbytes);
+    void *mymalloc_page(size_t nbytes);
 
     void *myrealloc(void *ptr, size_t size, const char *desc);
     int mycreate_path(const char *path);
@@ -97,6 +98,8 @@ struct ctx_params {
     void myframe_key(AVFrame *frame);
     void myframe_interlaced(AVFrame *frame);
     AVPacket *mypacket_alloc(AVPacket *pkt);
+    void myframe_roi(AVFrame *frame, std::vector<ctx_coord> &boxes
+        , int src_w, int src_h, int strength);
 
     void util_parms_parse(ctx_params *params, std::string parm_desc, std::string confline);
     void util_parms_add_default(ctx_params *params, std::string parm_nm, std::string parm_vl);
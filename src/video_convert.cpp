@@ -22,6 +22,272 @@
 #include "logger.hpp"
 #include "jpegutils.hpp"
 #include "video_convert.hpp"
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+
+/*
+ * Row kernels for the packed 4:2:2 formats.  Each call converts a pair
+ * of source rows starting at pixel x into two rows of Y and one row of
+ * U and V, the chroma being the truncated average of the two rows.
+ * yofs is the byte of the first Y in each pixel pair (0 for YUYV and
+ * 1 for UYVY).  The vector versions return the pixels done and the
+ * scalar version finishes the row.
+ */
+static void conv_422_c(const u_char *s0, const u_char *s1
+    , u_char *y0, u_char *y1, u_char *u, u_char *v
+    , int x, int w, int yofs)
+{
+    int cofs = 1 - yofs;
+
+    for (; x < w; x += 2) {
+        y0[x]   = s0[(2 * x) + yofs];
+        y0[x+1] = s0[(2 * x) + 2 + yofs];
+        y1[x]   = s1[(2 * x) + yofs];
+        y1[x+1] = s1[(2 * x) + 2 + yofs];
+        u[x/2] = (u_char)((s0[(2 * x) + cofs] + s1[(2 * x) + cofs]) / 2);
+        v[x/2] = (u_char)((s0[(2 * x) + 2 + cofs] + s1[(2 * x) + 2 + cofs]) / 2);
+    }
+}
+
+static void avg_rows_c(u_char *dst, const u_char *a, const u_char *b, int x, int n)
+{
+    for (; x < n; x++) {
+        dst[x] = (u_char)((a[x] + b[x]) / 2);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/* pavgb rounds up so the odd sums are taken back down */
+__attribute__((target("sse2")))
+static inline __m128i avg_trunc_sse2(__m128i a, __m128i b)
+{
+    return _mm_sub_epi8(_mm_avg_epu8(a, b)
+        , _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+}
+
+__attribute__((target("sse2")))
+static int conv_422_sse2(const u_char *s0, const u_char *s1
+    , u_char *y0, u_char *y1, u_char *u, u_char *v, int w, int yofs)
+{
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a, b, c, d, ya, yb, ca, cb, t;
+    int x;
+
+    for (x = 0; (x + 16) <= w; x += 16) {
+        a = _mm_loadu_si128((const __m128i *)(s0 + (2 * x)));
+        b = _mm_loadu_si128((const __m128i *)(s0 + (2 * x) + 16));
+        c = _mm_loadu_si128((const __m128i *)(s1 + (2 * x)));
+        d = _mm_loadu_si128((const __m128i *)(s1 + (2 * x) + 16));
+        if (yofs == 0) {
+            ya = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+            yb = _mm_packus_epi16(_mm_and_si128(c, mask), _mm_and_si128(d, mask));
+            ca = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+            cb = _mm_packus_epi16(_mm_srli_epi16(c, 8), _mm_srli_epi16(d, 8));
+        } else {
+            ya = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+            yb = _mm_packus_epi16(_mm_srli_epi16(c, 8), _mm_srli_epi16(d, 8));
+            ca = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+            cb = _mm_packus_epi16(_mm_and_si128(c, mask), _mm_and_si128(d, mask));
+        }
+        _mm_storeu_si128((__m128i *)(y0 + x), ya);
+        _mm_storeu_si128((__m128i *)(y1 + x), yb);
+
+        t = avg_trunc_sse2(ca, cb);
+        _mm_storel_epi64((__m128i *)(u + (x / 2))
+            , _mm_packus_epi16(_mm_and_si128(t, mask), zero));
+        _mm_storel_epi64((__m128i *)(v + (x / 2))
+            , _mm_packus_epi16(_mm_srli_epi16(t, 8), zero));
+    }
+    return x;
+}
+
+__attribute__((target("sse2")))
+static int avg_rows_sse2(u_char *dst, const u_char *a, const u_char *b, int n)
+{
+    int x;
+
+    for (x = 0; (x + 16) <= n; x += 16) {
+        _mm_storeu_si128((__m128i *)(dst + x), avg_trunc_sse2(
+            _mm_loadu_si128((const __m128i *)(a + x))
+            , _mm_loadu_si128((const __m128i *)(b + x))));
+    }
+    return x;
+}
+
+/* The 256 bit packs work within each 128 bit lane so the quad words
+ * are put back in order with a permute after each pack.
+ */
+__attribute__((target("avx2")))
+static inline __m256i pack_avx2(__m256i a, __m256i b)
+{
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+}
+
+__attribute__((target("avx2")))
+static int conv_422_avx2(const u_char *s0, const u_char *s1
+    , u_char *y0, u_char *y1, u_char *u, u_char *v, int w, int yofs)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
+    __m256i a, b, c, d, ya, yb, ca, cb, t;
+    int x;
+
+    for (x = 0; (x + 32) <= w; x += 32) {
+        a = _mm256_loadu_si256((const __m256i *)(s0 + (2 * x)));
+        b = _mm256_loadu_si256((const __m256i *)(s0 + (2 * x) + 32));
+        c = _mm256_loadu_si256((const __m256i *)(s1 + (2 * x)));
+        d = _mm256_loadu_si256((const __m256i *)(s1 + (2 * x) + 32));
+        if (yofs == 0) {
+            ya = pack_avx2(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask));
+            yb = pack_avx2(_mm256_and_si256(c, mask), _mm256_and_si256(d, mask));
+            ca = pack_avx2(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+            cb = pack_avx2(_mm256_srli_epi16(c, 8), _mm256_srli_epi16(d, 8));
+        } else {
+            ya = pack_avx2(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+            yb = pack_avx2(_mm256_srli_epi16(c, 8), _mm256_srli_epi16(d, 8));
+            ca = pack_avx2(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask));
+            cb = pack_avx2(_mm256_and_si256(c, mask), _mm256_and_si256(d, mask));
+        }
+        _mm256_storeu_si256((__m256i *)(y0 + x), ya);
+        _mm256_storeu_si256((__m256i *)(y1 + x), yb);
+
+        t = _mm256_sub_epi8(_mm256_avg_epu8(ca, cb)
+            , _mm256_and_si256(_mm256_xor_si256(ca, cb), one));
+        _mm_storeu_si128((__m128i *)(u + (x / 2)), _mm256_castsi256_si128(
+            pack_avx2(_mm256_and_si256(t, mask), zero)));
+        _mm_storeu_si128((__m128i *)(v + (x / 2)), _mm256_castsi256_si128(
+            pack_avx2(_mm256_srli_epi16(t, 8), zero)));
+    }
+    return x;
+}
+
+#elif defined(__ARM_NEON)
+
+static int conv_422_neon(const u_char *s0, const u_char *s1
+    , u_char *y0, u_char *y1, u_char *u, u_char *v, int w, int yofs)
+{
+    uint8x16x4_t a, b;
+    uint8x16x2_t ya, yb;
+    int x;
+
+    for (x = 0; (x + 32) <= w; x += 32) {
+        a = vld4q_u8(s0 + (2 * x));
+        b = vld4q_u8(s1 + (2 * x));
+        ya.val[0] = a.val[yofs];
+        ya.val[1] = a.val[2 + yofs];
+        yb.val[0] = b.val[yofs];
+        yb.val[1] = b.val[2 + yofs];
+        vst2q_u8(y0 + x, ya);
+        vst2q_u8(y1 + x, yb);
+        vst1q_u8(u + (x / 2), vhaddq_u8(a.val[1 - yofs], b.val[1 - yofs]));
+        vst1q_u8(v + (x / 2), vhaddq_u8(a.val[3 - yofs], b.val[3 - yofs]));
+    }
+    return x;
+}
+
+static int avg_rows_neon(u_char *dst, const u_char *a, const u_char *b, int n)
+{
+    int x;
+
+    for (x = 0; (x + 16) <= n; x += 16) {
+        vst1q_u8(dst + x, vhaddq_u8(vld1q_u8(a + x), vld1q_u8(b + x)));
+    }
+    return x;
+}
+
+#endif
+
+/* Choose the widest vector instructions of the running cpu */
+static enum CONVERT_SIMD convert_simd_detect()
+{
+    #if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return CONVERT_SIMD_AVX2;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return CONVERT_SIMD_SSE2;
+        }
+    #elif defined(__ARM_NEON)
+        return CONVERT_SIMD_NEON;
+    #endif
+    return CONVERT_SIMD_NONE;
+}
+
+static const char *convert_simd_name(enum CONVERT_SIMD simd)
+{
+    switch (simd) {
+    case CONVERT_SIMD_AVX2: return "avx2";
+    case CONVERT_SIMD_SSE2: return "sse2";
+    case CONVERT_SIMD_NEON: return "neon";
+    default:                return "none";
+    }
+}
+
+void cls_convert::rows_422(const u_char *s0, const u_char *s1
+    , u_char *y0, u_char *y1, u_char *u, u_char *v, int yofs)
+{
+    int x = 0;
+
+    #if defined(__x86_64__) || defined(__i386__)
+        if (simd == CONVERT_SIMD_AVX2) {
+            x = conv_422_avx2(s0, s1, y0, y1, u, v, width, yofs);
+        } else if (simd == CONVERT_SIMD_SSE2) {
+            x = conv_422_sse2(s0, s1, y0, y1, u, v, width, yofs);
+        }
+    #elif defined(__ARM_NEON)
+        if (simd == CONVERT_SIMD_NEON) {
+            x = conv_422_neon(s0, s1, y0, y1, u, v, width, yofs);
+        }
+    #endif
+    conv_422_c(s0, s1, y0, y1, u, v, x, width, yofs);
+}
+
+void cls_convert::avg_rows(u_char *dst, const u_char *a, const u_char *b, int n)
+{
+    int x = 0;
+
+    #if defined(__x86_64__) || defined(__i386__)
+        if ((simd == CONVERT_SIMD_AVX2) || (simd == CONVERT_SIMD_SSE2)) {
+            x = avg_rows_sse2(dst, a, b, n);
+        }
+    #elif defined(__ARM_NEON)
+        if (simd == CONVERT_SIMD_NEON) {
+            x = avg_rows_neon(dst, a, b, n);
+        }
+    #endif
+    avg_rows_c(dst, a, b, x, n);
+}
+
+/* Convert the packed 4:2:2 formats two rows at a time */
+void cls_convert::packed422to420p(u_char *img_dst, u_char *img_src, int yofs)
+{
+    u_char *dst_y, *dst_u, *dst_v;
+    int row, stride;
+
+    stride = width * 2;
+    dst_y = img_dst;
+    dst_u = img_dst + (width * height);
+    dst_v = dst_u + ((width * height) / 4);
+
+    for (row = 0; (row + 1) < height; row += 2) {
+        rows_422(img_src + (row * stride), img_src + ((row + 1) * stride)
+            , dst_y + (row * width), dst_y + ((row + 1) * width)
+            , dst_u + ((row / 2) * (width / 2)), dst_v + ((row / 2) * (width / 2))
+            , yofs);
+    }
+    if (row < height) {
+        for (int x = 0; x < width; x++) {
+            dst_y[(row * width) + x] = img_src[(row * stride) + (2 * x) + yofs];
+        }
+    }
+}
 
 /**
  * sonix_decompress_init
@@ -176,204 +442,127 @@ int cls_convert::sonix_decompress(u_char *img_dst, u_char *img_src)
     return 0;
 }
 
-/**
- * bayer2rgb24
+/*
+ * Bayer interpolation of the pixel at rawpt (index i).  The three values
+ * are returned in the order that the conversion to YUV takes as R, G, B.
  * BAYER2RGB24 ROUTINE TAKEN FROM:
  *
  * Sonix SN9C10x based webcam basic I/F routines
  * Takafumi Mizuno <taka-qce@ls-a.jp>
  *
  */
-void cls_convert::bayer2rgb24(u_char *img_dst, u_char *img_src)
+static inline void bayer_px(const u_char *rawpt, int i, int width, int height
+    , int &c0, int &c1, int &c2)
 {
-    int i;
-    u_char *rawpt, *scanpt;
-    int size;  /* width * height fits in int for any practical resolution */
-
-    rawpt = img_src;
-    scanpt = img_dst;
-    size = width * height;
-
-    for (i = 0; i < size; i++) {
-        if (((i / width) & 1) == 0) {
-            if ((i & 1) == 0) {
-                /* B */
-                if ((i > width) && ((i % width) > 0)) {
-                    *scanpt++ = (u_char)(*rawpt);        /* B */
-                    *scanpt++ = (u_char)((*(rawpt - 1) +
-                                *(rawpt + 1) +
-                                *(rawpt + width) +
-                                *(rawpt - width)) / 4);         /* G */
-                    *scanpt++ = (u_char)((*(rawpt - width - 1) +
-                                *(rawpt - width + 1) +
-                                *(rawpt + width - 1) +
-                                *(rawpt + width + 1)) / 4);     /* R */
-                } else {
-                    /* First line or left column. */
-                    *scanpt++ = (u_char)(*rawpt);        /* B */
-                    *scanpt++ = (u_char)((*(rawpt + 1) +
-                                *(rawpt + width)) / 2);         /* G */
-                    *scanpt++ = (u_char)(*(rawpt + width + 1));       /* R */
-                }
+    if (((i / width) & 1) == 0) {
+        if ((i & 1) == 0) {
+            if ((i > width) && ((i % width) > 0)) {
+                c0 = *rawpt;
+                c1 = (*(rawpt - 1) + *(rawpt + 1) +
+                    *(rawpt + width) + *(rawpt - width)) / 4;
+                c2 = (*(rawpt - width - 1) + *(rawpt - width + 1) +
+                    *(rawpt + width - 1) + *(rawpt + width + 1)) / 4;
             } else {
-                /* (B)G */
-                if ((i > width) && ((i % width) < (width - 1))) {
-                    *scanpt++ = (u_char)((*(rawpt - 1) +
-                                *(rawpt + 1)) / 2);             /* B */
-                    *scanpt++ = (u_char)(*rawpt);        /* G */
-                    *scanpt++ = (u_char)((*(rawpt + width) +
-                                *(rawpt - width)) / 2);  /* R */
-                } else {
-                    /* First line or right column. */
-                    *scanpt++ = (u_char)(*(rawpt - 1));      /* B */
-                    *scanpt++ = (u_char)(*rawpt);            /* G */
-                    *scanpt++ = (u_char)(*(rawpt + width));  /* R */
-                }
+                c0 = *rawpt;
+                c1 = (*(rawpt + 1) + *(rawpt + width)) / 2;
+                c2 = *(rawpt + width + 1);
             }
         } else {
-            if ((i & 1) == 0) {
-                /* G(R) */
-                if ((i < (width * (height - 1))) && ((i % width) > 0)) {
-                    *scanpt++ =(u_char)( (*(rawpt + width) +
-                                *(rawpt - width)) / 2);                 /* B */
-                    *scanpt++ =(u_char)( *rawpt);                /* G */
-                    *scanpt++ =(u_char)( (*(rawpt - 1) +
-                                *(rawpt + 1)) / 2);                     /* R */
-                } else {
-                    /* Bottom line or left column. */
-                    *scanpt++ = (u_char)(*(rawpt - width));      /* B */
-                    *scanpt++ = (u_char)(*rawpt);                /* G */
-                    *scanpt++ = (u_char)(*(rawpt + 1));          /* R */
-                }
+            if ((i > width) && ((i % width) < (width - 1))) {
+                c0 = (*(rawpt - 1) + *(rawpt + 1)) / 2;
+                c1 = *rawpt;
+                c2 = (*(rawpt + width) + *(rawpt - width)) / 2;
             } else {
-                /* R */
-                if (i < (width * (height - 1)) && ((i % width) < (width - 1))) {
-                    *scanpt++ = (u_char)( (*(rawpt - width - 1) +
-                                *(rawpt - width + 1) +
-                                *(rawpt + width - 1) +
-                                *(rawpt + width + 1)) / 4);             /* B */
-                    *scanpt++ = (u_char)((*(rawpt - 1) +
-                                *(rawpt + 1) +
-                                *(rawpt - width) +
-                                *(rawpt + width)) / 4);                 /* G */
-                    *scanpt++ = (u_char)(*rawpt);                /* R */
-                } else {
-                    /* Bottom line or right column. */
-                    *scanpt++ = (u_char)(*(rawpt - width - 1));  /* B */
-                    *scanpt++ = (u_char)((*(rawpt - 1) +
-                                *(rawpt - width)) / 2);                 /* G */
-                    *scanpt++ = (u_char)(*rawpt);                /* R */
-                }
+                c0 = *(rawpt - 1);
+                c1 = *rawpt;
+                c2 = *(rawpt + width);
+            }
+        }
+    } else {
+        if ((i & 1) == 0) {
+            if ((i < (width * (height - 1))) && ((i % width) > 0)) {
+                c0 = (*(rawpt + width) + *(rawpt - width)) / 2;
+                c1 = *rawpt;
+                c2 = (*(rawpt - 1) + *(rawpt + 1)) / 2;
+            } else {
+                c0 = *(rawpt - width);
+                c1 = *rawpt;
+                c2 = *(rawpt + 1);
+            }
+        } else {
+            if ((i < (width * (height - 1))) && ((i % width) < (width - 1))) {
+                c0 = (*(rawpt - width - 1) + *(rawpt - width + 1) +
+                    *(rawpt + width - 1) + *(rawpt + width + 1)) / 4;
+                c1 = (*(rawpt - 1) + *(rawpt + 1) +
+                    *(rawpt - width) + *(rawpt + width)) / 4;
+                c2 = *rawpt;
+            } else {
+                c0 = *(rawpt - width - 1);
+                c1 = (*(rawpt - 1) + *(rawpt - width)) / 2;
+                c2 = *rawpt;
             }
         }
-        rawpt++;
     }
-
 }
 
-void cls_convert::yuv422to420p(u_char *img_dst, u_char *img_src)
+/*
+ * Bayer directly to YUV420P in one pass.  The values match converting
+ * to RGB24 and then with rgb24toyuv420p without the RGB buffer.
+ */
+void cls_convert::bayertoyuv420p(u_char *img_dst, u_char *img_src)
 {
-    u_char *src, *dest, *src2, *dest2;
-    int i, j;
-
-    /* Create the Y plane. */
-    src = img_src;
-    dest = img_dst;
-    for (i = width * height; i > 0; i--) {
-        *dest++ = *src;
-        src += 2;
-    }
-    /* Create U and V planes. */
-    src = img_src + 1;
-    src2 = img_src + width * 2 + 1;
-    dest = img_dst + width * height;
-    dest2 = dest + (width * height) / 4;
-    for (i = height / 2; i > 0; i--) {
-        for (j = width / 2; j > 0; j--) {
-            *dest = (u_char)(((int) *src + (int) *src2) / 2);
-            src += 2;
-            src2 += 2;
-            dest++;
-            *dest2 = (u_char)(((int) *src + (int) *src2) / 2);
-            src += 2;
-            src2 += 2;
-            dest2++;
+    u_char *y, *u, *v;
+    int row, x, indx, r, g, b;
+
+    y = img_dst;
+    u = y + (width * height);
+    v = u + ((width * height) / 4);
+    memset(u, 0, (uint)(width * height) / 4);
+    memset(v, 0, (uint)(width * height) / 4);
+
+    indx = 0;
+    for (row = 0; row < height; row++) {
+        for (x = 0; x < width; x++) {
+            bayer_px(img_src + indx, indx, width, height, r, g, b);
+            y[indx] = (u_char)((9796 * r + 19235 * g + 3736 * b) >> 15);
+            u[x / 2] += (u_char)(((-4784 * r - 9437 * g + 14221 * b) >> 17) + 32);
+            v[x / 2] += (u_char)(((20218 * r - 16941 * g - 3277 * b) >> 17) + 32);
+            indx++;
+        }
+        if ((row & 1) == 1) {
+            u += width / 2;
+            v += width / 2;
         }
-        src += width * 2;
-        src2 += width * 2;
     }
 }
 
+void cls_convert::yuv422to420p(u_char *img_dst, u_char *img_src)
+{
+    packed422to420p(img_dst, img_src, 0);
+}
+
 void cls_convert::yuv422pto420p(u_char *img_dst, u_char *img_src)
 {
-    u_char *src, *dest, *dest2;
-    u_char *src_u, *src_u2, *src_v, *src_v2;
+    u_char *src_u, *src_v, *dst_u, *dst_v;
+    int i, cw;
 
-    int i, j;
     /*Planar version of 422 */
-    /* Create the Y plane. */
-    src = img_src;
-    dest = img_dst;
-    for (i = width * height; i > 0; i--) {
-        *dest++ = *src++;
-    }
-
-    /* Create U and V planes. */
-    dest = img_dst + width * height;
-    dest2 = dest + (width * height) / 4;
-    for (i = 0; i< (height / 2); i++) {
-        src_u = img_src + (width * height) + ((i*2) * (width/2));
-        src_u2 = src_u  + (width/2);
-        src_v = src_u + (width/2 * height);
-        src_v2 = src_v  + (width/2);
-
-        for (j = 0; j < (width / 2); j++) {
-            *dest = (u_char)(((int) *src_u + (int) *src_u2) / 2);
-            src_u ++;
-            src_u2++;
-            dest++;
-
-            *dest2 = (u_char)(((int) *src_v + (int) *src_v2) / 2);
-            src_v ++;
-            src_v2++;
-            dest2++;
-        }
+    memcpy(img_dst, img_src, (uint)(width * height));
+
+    cw = width / 2;
+    src_u = img_src + (width * height);
+    src_v = src_u + (cw * height);
+    dst_u = img_dst + (width * height);
+    dst_v = dst_u + ((width * height) / 4);
+    for (i = 0; i < (height / 2); i++) {
+        avg_rows(dst_u + (i * cw), src_u + ((i * 2) * cw), src_u + (((i * 2) + 1) * cw), cw);
+        avg_rows(dst_v + (i * cw), src_v + ((i * 2) * cw), src_v + (((i * 2) + 1) * cw), cw);
     }
 }
 
 void cls_convert::uyvyto420p(u_char *img_dst, u_char *img_src)
 {
-    u_char *pY = img_dst;
-    u_char *pU = pY + (width * height);
-    u_char *pV = pU + (width * height) / 4;
-    unsigned int uv_offset = (uint)width * 2 * sizeof(u_char);
-    int ix, jx;
-
-    for (ix = 0; ix < height; ix++) {
-        for (jx = 0; jx < width; jx += 2) {
-            unsigned short int calc;
-
-            if ((ix&1) == 0) {
-                calc = *img_src;
-                calc += *(img_src + uv_offset);
-                calc /= 2;
-                *pU++ = (u_char) calc;
-            }
-
-            img_src++;
-            *pY++ = *img_src++;
-
-            if ((ix&1) == 0) {
-                calc = *img_src;
-                calc += *(img_src + uv_offset);
-                calc /= 2;
-                *pV++ = (u_char) calc;
-            }
-
-            img_src++;
-            *pY++ = *img_src++;
-        }
-    }
+    packed422to420p(img_dst, img_src, 1);
 }
 
 void cls_convert::rgb_bgr(u_char *img_dst, u_char *img_src, int rgb)
@@ -482,33 +671,26 @@ int cls_convert::mjpegtoyuv420p(u_char *img_dst, u_char *img_src, int size)
     return ret;
 }
 
-void cls_convert::y10torgb24(u_char *img_dst, u_char *img_src, int shift)
+/* Grey 16 bit formats directly to YUV420P.  The luma matches the
+ * RGB path which gives (32767 * a) >> 15 and neutral chroma.
+ */
+void cls_convert::y10toyuv420p(u_char *img_dst, u_char *img_src, int shift)
 {
     /* Source code: raw2rgbpnm project */
     /* url: http://salottisipuli.retiisi.org.uk/cgi-bin/gitweb.cgi?p=~sailus/raw2rgbpnm.git;a=summary */
 
-    /* bpp - bits per pixel */
     /* bpp: 'Pixels are stored in 16-bit words with unused high bits padded with 0' */
     /* url: https://linuxtv.org/downloads/v4l-dvb-apis/V4L2-PIX-FMT-Y12.html */
     /* url: https://linuxtv.org/downloads/v4l-dvb-apis/V4L2-PIX-FMT-Y10.html */
 
-    int src_size[2] = {width,height};
-    int bpp = 16;
-    int src_stride =((src_size[0] * bpp) / 8);
-    int rgb_stride =(src_size[0] * 3);
-    int a = 0;
-    int src_x = 0, src_y = 0;
-    int dst_x = 0, dst_y = 0;
-
-    for (src_y = 0, dst_y = 0; dst_y < src_size[1]; src_y++, dst_y++) {
-        for (src_x = 0, dst_x = 0; dst_x < src_size[0]; src_x++, dst_x++) {
-            a = (img_src[(uint)(src_y*src_stride + src_x*2+0)] |
-                (img_src[(uint)(src_y*src_stride + src_x*2+1)] << 8)) >> shift;
-            img_dst[(uint)(dst_y*rgb_stride+3*dst_x+0)] = (u_char)a;
-            img_dst[(uint)(dst_y*rgb_stride+3*dst_x+1)] = (u_char)a;
-            img_dst[(uint)(dst_y*rgb_stride+3*dst_x+2)] = (u_char)a;
-        }
+    int indx;
+    u_char a;
+
+    for (indx = 0; indx < (width * height); indx++) {
+        a = (u_char)((img_src[2 * indx] | (img_src[(2 * indx) + 1] << 8)) >> shift);
+        img_dst[indx] = (u_char)((32767 * a) >> 15);
     }
+    memset(img_dst + (width * height), 128, (uint)(width * height) / 2);
 }
 
 void cls_convert::greytoyuv420p(u_char *img_dst, u_char *img_src)
@@ -557,30 +739,25 @@ int cls_convert::process(u_char *img_dst, u_char *img_src, int clen)
         case V4L2_PIX_FMT_SGRBG8:
             /*FALLTHROUGH*/
         case V4L2_PIX_FMT_SBGGR8:    /* bayer */
-            bayer2rgb24(common_buffer, img_src);
-            rgb24toyuv420p(img_dst, common_buffer);
+            bayertoyuv420p(img_dst, img_src);
             return 0;
 
         case V4L2_PIX_FMT_SRGGB8: /*New Pi Camera format*/
-            bayer2rgb24(common_buffer, img_src);
-            rgb24toyuv420p(img_dst, common_buffer);
+            bayertoyuv420p(img_dst, img_src);
             return 0;
 
         case V4L2_PIX_FMT_SPCA561:
             /*FALLTHROUGH*/
         case V4L2_PIX_FMT_SN9C10X:
-            sonix_decompress(img_dst, img_src);
-            bayer2rgb24(common_buffer, img_dst);
-            rgb24toyuv420p(img_dst, common_buffer);
+            sonix_decompress(common_buffer, img_src);
+            bayertoyuv420p(img_dst, common_buffer);
             return 0;
 
         case V4L2_PIX_FMT_Y12:
-            y10torgb24(common_buffer, img_src, 2);
-            rgb24toyuv420p(img_dst, common_buffer);
+            y10toyuv420p(img_dst, img_src, 2);
             return 0;
         case V4L2_PIX_FMT_Y10:
-            y10torgb24(common_buffer, img_src, 4);
-            rgb24toyuv420p(img_dst, common_buffer);
+            y10toyuv420p(img_dst, img_src, 4);
             return 0;
         case V4L2_PIX_FMT_GREY:
             greytoyuv420p(img_dst, img_src);
@@ -602,9 +779,13 @@ cls_convert::cls_convert(cls_camera *p_cam, int p_pix, int p_w, int p_h)
     width = p_w;
     height = p_h;
     pixfmt_src = p_pix;
+    simd = convert_simd_detect();
 
     common_buffer =(u_char*) mymalloc((uint)(3 * width * height));
 
+    MOTION_LOG(INF, TYPE_VIDEO, NO_ERRNO
+        ,_("Pixel conversion using %s instructions"), convert_simd_name(simd));
+
 }
 
 cls_convert::~cls_convert()
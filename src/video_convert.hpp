@@ -19,6 +19,13 @@
 #ifndef _INCLUDE_VIDEO_COMMON_HPP_
 #define _INCLUDE_VIDEO_COMMON_HPP_
 
+enum CONVERT_SIMD {
+    CONVERT_SIMD_NONE,
+    CONVERT_SIMD_SSE2,
+    CONVERT_SIMD_AVX2,
+    CONVERT_SIMD_NEON
+};
+
 typedef struct {
     int is_abs;
     int len;
@@ -37,19 +44,24 @@ class cls_convert {
         int width;
         int height;
         int pixfmt_src;
+        enum CONVERT_SIMD simd;     /* Vector instructions chosen at startup */
         u_char  *common_buffer;
 
 
         void sonix_decompress_init(sonix_table *table);
         void rgb_bgr(u_char *img_dst, u_char *img_src, int rgb);
+        void rows_422(const u_char *s0, const u_char *s1
+            , u_char *y0, u_char *y1, u_char *u, u_char *v, int yofs);
+        void avg_rows(u_char *dst, const u_char *a, const u_char *b, int n);
+        void packed422to420p(u_char *img_dst, u_char *img_src, int yofs);
 
         void yuv422to420p(u_char *img_dest, u_char *img_src);
         void yuv422pto420p(u_char *img_dest, u_char *img_src);
         void uyvyto420p(u_char *img_dest, u_char *img_src);
         void rgb24toyuv420p(u_char *img_dest, u_char *img_src);
         void bgr24toyuv420p(u_char *img_dest, u_char *img_src);
-        void bayer2rgb24(u_char *img_dst, u_char *img_src);
-        void y10torgb24(u_char *img_dest, u_char *img_src, int shift);
+        void bayertoyuv420p(u_char *img_dst, u_char *img_src);
+        void y10toyuv420p(u_char *img_dst, u_char *img_src, int shift);
         void greytoyuv420p(u_char *img_dest, u_char *img_src);
         int sonix_decompress(u_char *img_dest, u_char *img_src);
         int mjpegtoyuv420p(u_char *img_dest, u_char *img_src, int size);
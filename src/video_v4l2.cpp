@@ -22,12 +22,18 @@
 #include "conf.hpp"
 #include "logger.hpp"
 #include "rotate.hpp"
+#include "profile.hpp"
+#include "evwait.hpp"
 #include "video_convert.hpp"
 #include "video_v4l2.hpp"
 #include <sys/mman.h>
+#ifdef HAVE_SYS_EPOLL_H
+    #include <sys/epoll.h>
+#endif
 
 #define MMAP_BUFFERS            4
 #define MIN_MMAP_BUFFERS        2
+#define MAX_MMAP_BUFFERS        32
 
 #ifdef HAVE_V4L2
 
@@ -715,11 +721,83 @@ void cls_v4l2cam::palette_set()
 }
 
 /* Set the memory mapping from device to Motion*/
+/* Map the buffers allocated by the driver */
 void cls_v4l2cam::set_mmap()
 {
-    enum v4l2_buf_type type;
     int buffer_index;
 
+    for (buffer_index = 0; buffer_index < buffer_count; buffer_index++) {
+        struct v4l2_buffer p_buf;
+
+        memset(&p_buf, 0, sizeof(struct v4l2_buffer));
+
+        p_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        p_buf.memory = V4L2_MEMORY_MMAP;
+        p_buf.index = (uint)buffer_index;
+        if (xioctl(VIDIOC_QUERYBUF, &p_buf) == -1) {
+            MOTION_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO
+                ,_("Error querying buffer %i\nVIDIOC_QUERYBUF: ")
+                ,buffer_index);
+            buffer_count = buffer_index;
+            device_close();
+            return;
+        }
+
+        buffers[buffer_index].size = p_buf.length;
+        buffers[buffer_index].ptr =(unsigned char*) mmap(
+            nullptr, p_buf.length, PROT_READ | PROT_WRITE
+            , MAP_SHARED, fd_device, p_buf.m.offset);
+
+        if (buffers[buffer_index].ptr == MAP_FAILED) {
+            MOTION_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO
+                ,_("Error mapping buffer %i mmap"), buffer_index);
+            buffer_count = buffer_index;
+            device_close();
+            return;
+        }
+
+        MOTION_LOG(DBG, TYPE_VIDEO, NO_ERRNO
+            ,_("%i length=%d Address (%p)")
+            ,buffer_index, p_buf.length, (void*)buffers[buffer_index].ptr);
+    }
+}
+
+/* Allocate the buffers that the driver fills.  For YUV420 images
+ * without padding they are the size of a ring image so that they can
+ * be exchanged with the ring images instead of copied.
+ */
+void cls_v4l2cam::set_userptr()
+{
+    int buffer_index;
+    size_t sz, frame_sz;
+
+    frame_sz = (size_t)((cam->cfg->width * cam->cfg->height * 3) / 2);
+    zero_copy = ((pixfmt_src == V4L2_PIX_FMT_YUV420) &&
+        (vidfmt.fmt.pix.sizeimage <= frame_sz) &&
+        ((vidfmt.fmt.pix.bytesperline == 0) ||
+         ((int)vidfmt.fmt.pix.bytesperline == cam->cfg->width)));
+    if (zero_copy) {
+        sz = frame_sz;
+    } else {
+        sz = MAX(vidfmt.fmt.pix.sizeimage, frame_sz);
+    }
+
+    for (buffer_index = 0; buffer_index < buffer_count; buffer_index++) {
+        buffers[buffer_index].size = sz;
+        buffers[buffer_index].ptr =(unsigned char*) mymalloc_page(sz);
+    }
+
+    MOTION_LOG(NTC, TYPE_VIDEO, NO_ERRNO
+        ,_("User pointer buffers=%d size=%d%s"), buffer_count, (int)sz
+        , (zero_copy ? " (images exchanged with the ring)" : ""));
+}
+
+/* Request and queue the capture buffers and start streaming */
+void cls_v4l2cam::set_buffers()
+{
+    enum v4l2_buf_type type;
+    int buffer_index, cnt, indx;
+
     if (fd_device == -1) {
         return;
     }
@@ -729,12 +807,38 @@ void cls_v4l2cam::set_mmap()
         return;
     }
 
+    cnt = MMAP_BUFFERS;
+    buf_memory = V4L2_MEMORY_MMAP;
+    for (indx=0;indx<params->params_cnt;indx++) {
+        if (params->params_array[indx].param_name == "buffers") {
+            cnt = mtoi(params->params_array[indx].param_value);
+        }
+        if ((params->params_array[indx].param_name == "memory") &&
+            (params->params_array[indx].param_value == "userptr")) {
+            buf_memory = V4L2_MEMORY_USERPTR;
+        }
+    }
+    if ((cnt < MIN_MMAP_BUFFERS) || (cnt > MAX_MMAP_BUFFERS)) {
+        MOTION_LOG(WRN, TYPE_VIDEO, NO_ERRNO
+            ,_("Invalid buffers %d.  Changing to default"), cnt);
+        cnt = MMAP_BUFFERS;
+    }
+
     memset(&vidreq, 0, sizeof(struct v4l2_requestbuffers));
 
-    vidreq.count = MMAP_BUFFERS;
+    vidreq.count = (uint)cnt;
     vidreq.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    vidreq.memory = V4L2_MEMORY_MMAP;
-    if (xioctl(VIDIOC_REQBUFS, &vidreq) == -1) {
+    vidreq.memory = buf_memory;
+    if ((buf_memory == V4L2_MEMORY_USERPTR) &&
+        (xioctl(VIDIOC_REQBUFS, &vidreq) == -1)) {
+        MOTION_LOG(WRN, TYPE_VIDEO, SHOW_ERRNO
+            ,_("Device does not support user pointers.  Using memory map"));
+        buf_memory = V4L2_MEMORY_MMAP;
+        vidreq.count = (uint)cnt;
+        vidreq.memory = buf_memory;
+    }
+    if ((buf_memory == V4L2_MEMORY_MMAP) &&
+        (xioctl(VIDIOC_REQBUFS, &vidreq) == -1)) {
         MOTION_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO
             ,_("Error requesting buffers %d for memory map. VIDIOC_REQBUFS")
             ,vidreq.count);
@@ -761,47 +865,25 @@ void cls_v4l2cam::set_mmap()
         return;
     }
 
-    for (buffer_index = 0; buffer_index < buffer_count; buffer_index++) {
-        struct v4l2_buffer p_buf;
-
-        memset(&p_buf, 0, sizeof(struct v4l2_buffer));
-
-        p_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        p_buf.memory = V4L2_MEMORY_MMAP;
-        p_buf.index = (uint)buffer_index;
-        if (xioctl(VIDIOC_QUERYBUF, &p_buf) == -1) {
-            MOTION_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO
-                ,_("Error querying buffer %i\nVIDIOC_QUERYBUF: ")
-                ,buffer_index);
-            myfree(buffers);
-            device_close();
-            return;
-        }
-
-        buffers[buffer_index].size = p_buf.length;
-        buffers[buffer_index].ptr =(unsigned char*) mmap(
-            nullptr, p_buf.length, PROT_READ | PROT_WRITE
-            , MAP_SHARED, fd_device, p_buf.m.offset);
-
-        if (buffers[buffer_index].ptr == MAP_FAILED) {
-            MOTION_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO
-                ,_("Error mapping buffer %i mmap"), buffer_index);
-            myfree(buffers);
-            device_close();
-            return;
-        }
-
-        MOTION_LOG(DBG, TYPE_VIDEO, NO_ERRNO
-            ,_("%i length=%d Address (%p)")
-            ,buffer_index, p_buf.length, (void*)buffers[buffer_index].ptr);
+    if (buf_memory == V4L2_MEMORY_USERPTR) {
+        set_userptr();
+    } else {
+        set_mmap();
+    }
+    if (fd_device == -1) {
+        return;
     }
 
     for (buffer_index = 0; buffer_index < buffer_count; buffer_index++) {
         memset(&vidbuf, 0, sizeof(struct v4l2_buffer));
 
         vidbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        vidbuf.memory = V4L2_MEMORY_MMAP;
+        vidbuf.memory = buf_memory;
         vidbuf.index = (uint)buffer_index;
+        if (buf_memory == V4L2_MEMORY_USERPTR) {
+            vidbuf.m.userptr = (unsigned long)buffers[buffer_index].ptr;
+            vidbuf.length = (uint)buffers[buffer_index].size;
+        }
 
         if (xioctl(VIDIOC_QBUF, &vidbuf) == -1) {
             MOTION_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO, "VIDIOC_QBUF");
@@ -836,6 +918,54 @@ void cls_v4l2cam::set_imgs()
 
 }
 
+/* Return a buffer to the driver */
+int cls_v4l2cam::buffer_queue(struct v4l2_buffer *buf)
+{
+    if (buf_memory == V4L2_MEMORY_USERPTR) {
+        buf->m.userptr = (unsigned long)buffers[buf->index].ptr;
+        buf->length = (uint)buffers[buf->index].size;
+    }
+    return xioctl(VIDIOC_QBUF, buf);
+}
+
+/* Take the buffer the reactor dequeued, waiting for one if needed */
+int cls_v4l2cam::capture_ready()
+{
+    int waitcnt;
+    bool got, failed;
+
+    waitcnt = 0;
+    while (true) {
+        pthread_mutex_lock(&mutex_ready);
+            got = ready_valid;
+            failed = ready_error;
+            if (got) {
+                vidbuf = ready_buf;
+                ready_valid = false;
+            }
+        pthread_mutex_unlock(&mutex_ready);
+
+        if (got) {
+            return 0;
+        }
+        if (failed) {
+            MOTION_LOG(ERR, TYPE_VIDEO, NO_ERRNO
+                ,_("Device no longer provides buffers"));
+            return -1;
+        }
+        if ((cam->restart == true) || (cam->handler_stop == true) ||
+            (waitcnt >= cam->cfg->watchdog_tmo)) {
+            MOTION_LOG(ERR, TYPE_VIDEO, NO_ERRNO
+                ,_("Timed out waiting for a buffer"));
+            return -1;
+        }
+        cam->watchdog = cam->cfg->watchdog_tmo;
+        if (evwait_ready->wait_for(1, 0) == false) {
+            waitcnt++;
+        }
+    }
+}
+
 /* Capture the image into the buffer */
 int cls_v4l2cam::capture()
 {
@@ -853,25 +983,34 @@ int cls_v4l2cam::capture()
     pthread_sigmask(SIG_BLOCK, &set, &old);
 
     if (pframe >= 0) {
-        retcd = xioctl(VIDIOC_QBUF, &vidbuf);
+        retcd = buffer_queue(&vidbuf);
         if (retcd == -1) {
             MOTION_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO, "VIDIOC_QBUF");
             pthread_sigmask(SIG_UNBLOCK, &old, nullptr);
             return -1;
         }
+        pframe = -1;
     }
 
-    memset(&vidbuf, 0, sizeof(struct v4l2_buffer));
+    if (reactor) {
+        retcd = capture_ready();
+        if (retcd == -1) {
+            pthread_sigmask(SIG_UNBLOCK, &old, nullptr);
+            return -1;
+        }
+    } else {
+        memset(&vidbuf, 0, sizeof(struct v4l2_buffer));
 
-    vidbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    vidbuf.memory = V4L2_MEMORY_MMAP;
-    vidbuf.bytesused = 0;
+        vidbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        vidbuf.memory = buf_memory;
+        vidbuf.bytesused = 0;
 
-    retcd = xioctl(VIDIOC_DQBUF, &vidbuf);
-    if (retcd == -1) {
-        MOTION_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO, "VIDIOC_DQBUF");
-        pthread_sigmask(SIG_UNBLOCK, &old, nullptr);
-        return -1;
+        retcd = xioctl(VIDIOC_DQBUF, &vidbuf);
+        if (retcd == -1) {
+            MOTION_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO, "VIDIOC_DQBUF");
+            pthread_sigmask(SIG_UNBLOCK, &old, nullptr);
+            return -1;
+        }
     }
 
     pframe = (int)vidbuf.index;
@@ -883,12 +1022,145 @@ int cls_v4l2cam::capture()
 
 }
 
+/*
+ * Dequeue every buffer the driver has filled.  Called from the reactor
+ * thread when the device is readable.  Only the newest buffer is kept
+ * for the camera so a slow pipeline processes current images rather
+ * than a backlog.  Returns false when the device has failed.
+ */
+bool cls_v4l2cam::reactor_dequeue()
+{
+    struct v4l2_buffer buf;
+    bool woke;
+    int retcd;
+
+    woke = false;
+    while (true) {
+        memset(&buf, 0, sizeof(struct v4l2_buffer));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = buf_memory;
+
+        do {
+            retcd = ioctl(fd_device, VIDIOC_DQBUF, &buf);
+        } while ((retcd == -1) && (errno == EINTR));
+
+        if (retcd == -1) {
+            if (errno == EAGAIN) {
+                break;
+            }
+            MOTION_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO, "VIDIOC_DQBUF");
+            pthread_mutex_lock(&mutex_ready);
+                ready_error = true;
+            pthread_mutex_unlock(&mutex_ready);
+            evwait_ready->wake();
+            return false;
+        }
+
+        pthread_mutex_lock(&mutex_ready);
+            if (ready_valid) {
+                if (buffer_queue(&ready_buf) == -1) {
+                    MOTION_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO, "VIDIOC_QBUF");
+                }
+                ready_dropped++;
+            }
+            ready_buf = buf;
+            ready_valid = true;
+        pthread_mutex_unlock(&mutex_ready);
+        woke = true;
+    }
+
+    if (woke) {
+        evwait_ready->wake();
+    }
+
+    return true;
+}
+
+/* Register the device with the reactor when requested */
+void cls_v4l2cam::set_reactor()
+{
+    int indx, flags;
+    bool want;
+
+    if (fd_device == -1) {
+        return;
+    }
+
+    want = false;
+    for (indx=0;indx<params->params_cnt;indx++) {
+        if ((params->params_array[indx].param_name == "capture") &&
+            (params->params_array[indx].param_value == "reactor")) {
+            want = true;
+        }
+    }
+    if (want == false) {
+        return;
+    }
+
+    #ifdef HAVE_SYS_EPOLL_H
+        flags = fcntl(fd_device, F_GETFL);
+        fcntl(fd_device, F_SETFL, flags | O_NONBLOCK);
+        if (cam->app->v4l2poll->add(this, fd_device)) {
+            reactor = true;
+            MOTION_LOG(NTC, TYPE_VIDEO, NO_ERRNO
+                ,_("Buffers dequeued by the capture reactor"));
+        } else {
+            fcntl(fd_device, F_SETFL, flags);
+        }
+    #else
+        (void)flags;
+        MOTION_LOG(WRN, TYPE_VIDEO, NO_ERRNO
+            ,_("epoll not available.  Using capture wait"));
+    #endif
+}
+
+/*
+ * Use the time the driver filled the buffer rather than the time it
+ * was dequeued so the images are not offset by scheduling delays.
+ * Only monotonic driver clocks can be related to the system clocks.
+ */
+void cls_v4l2cam::set_timestamp(ctx_image_data *img_data)
+{
+    struct timespec ts_mono, ts_real;
+    int64_t age;
+
+    if ((vidbuf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) !=
+        V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+        return;
+    }
+    if ((vidbuf.timestamp.tv_sec == 0) && (vidbuf.timestamp.tv_usec == 0)) {
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts_mono);
+    clock_gettime(CLOCK_REALTIME, &ts_real);
+
+    age = ((ts_mono.tv_sec - vidbuf.timestamp.tv_sec) * 1000000L) +
+        ((ts_mono.tv_nsec / 1000) - vidbuf.timestamp.tv_usec);
+    if ((age < 0) || (age > 1000000L)) {
+        return;
+    }
+
+    img_data->monots.tv_sec = vidbuf.timestamp.tv_sec;
+    img_data->monots.tv_nsec = vidbuf.timestamp.tv_usec * 1000;
+
+    age = ((int64_t)ts_real.tv_sec * 1000000000L) + ts_real.tv_nsec - (age * 1000);
+    img_data->imgts.tv_sec = (time_t)(age / 1000000000L);
+    img_data->imgts.tv_nsec = (long)(age % 1000000000L);
+}
+
 void cls_v4l2cam::init_vars()
 {
     buffer_count= 0;
     pframe = -1;
     buffers = nullptr;
     convert = nullptr;
+    zero_copy = false;
+    reactor = false;
+    ready_valid = false;
+    ready_error = false;
+    ready_dropped = 0;
+    buf_memory = V4L2_MEMORY_MMAP;
 
     params = new ctx_params;
     params->params_cnt = 0;
@@ -897,6 +1169,9 @@ void cls_v4l2cam::init_vars()
     util_parms_add_default(params, "palette", "17");
     util_parms_add_default(params, "norm", "0");
     util_parms_add_default(params, "frequency", "0");
+    util_parms_add_default(params, "buffers", MMAP_BUFFERS);
+    util_parms_add_default(params, "memory", "mmap");
+    util_parms_add_default(params, "capture", "wait");
 
     palette_init();
 }
@@ -1084,14 +1359,28 @@ void cls_v4l2cam::stop_cam()
 
     p_type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
+    if (reactor) {
+        cam->app->v4l2poll->remove(this, fd_device);
+        reactor = false;
+        if (ready_dropped > 0) {
+            MOTION_LOG(INF, TYPE_VIDEO, NO_ERRNO
+                ,_("Capture reactor replaced %d unprocessed buffers")
+                , ready_dropped);
+        }
+    }
+
     if (fd_device != -1) {
         xioctl(VIDIOC_STREAMOFF, &p_type);
         device_close();
     }
 
     if (buffers != nullptr) {
-        for (indx = 0; indx < (int)vidreq.count; indx++){
-            munmap(buffers[indx].ptr, buffers[indx].size);
+        for (indx = 0; indx < buffer_count; indx++){
+            if (buf_memory == V4L2_MEMORY_USERPTR) {
+                myfree(buffers[indx].ptr);
+            } else {
+                munmap(buffers[indx].ptr, buffers[indx].size);
+            }
         }
         myfree(buffers);
     }
@@ -1117,7 +1406,8 @@ void cls_v4l2cam::start_cam()
     set_fps();
     ctrls_list();
     ctrls_set();
-    set_mmap();
+    set_buffers();
+    set_reactor();
     set_imgs();
     if (fd_device == -1) {
         MOTION_LOG(ERR, TYPE_VIDEO, NO_ERRNO,_("V4L2 device failed to open"));
@@ -1165,13 +1455,27 @@ int cls_v4l2cam::next(ctx_image_data *img_data)
 {
     #ifdef HAVE_V4L2
         int retcd;
+        int64_t prof_ts;
 
         cam->watchdog = cam->cfg->watchdog_tmo;
         retcd = capture();
         if (retcd != 0) {
             return CAPTURE_FAILURE;
         }
+        set_timestamp(img_data);
+
+        /* The filled buffer becomes the ring image and the old ring
+         * image is queued to the driver in its place.
+         */
+        if (zero_copy &&
+            (buffers[vidbuf.index].content_length >= cam->imgs.size_norm) &&
+            (((uintptr_t)img_data->image_norm % (uintptr_t)sysconf(_SC_PAGESIZE)) == 0)) {
+            std::swap(img_data->image_norm, buffers[vidbuf.index].ptr);
+            cam->rotate->process(img_data);
+            return CAPTURE_SUCCESS;
+        }
 
+        prof_ts = cam->profile->now();
         retcd = convert->process(
             img_data->image_norm
             , buffers[vidbuf.index].ptr
@@ -1179,6 +1483,7 @@ int cls_v4l2cam::next(ctx_image_data *img_data)
         if (retcd != 0) {
             return CAPTURE_FAILURE;
         }
+        cam->profile->record(PROF_CONVERT, prof_ts);
 
         cam->rotate->process(img_data);
 
@@ -1192,6 +1497,9 @@ int cls_v4l2cam::next(ctx_image_data *img_data)
 cls_v4l2cam::cls_v4l2cam(cls_camera *p_cam)
 {
     cam = p_cam;
+    reactor = false;
+    pthread_mutex_init(&mutex_ready, nullptr);
+    evwait_ready = new cls_evwait();
     #ifdef HAVE_V4L2
         cam->watchdog = cam->cfg->watchdog_tmo * 3;
         start_cam();
@@ -1206,4 +1514,186 @@ cls_v4l2cam::~cls_v4l2cam()
         stop_cam();
     #endif
     cam->device_status = STATUS_CLOSED;
+    pthread_mutex_destroy(&mutex_ready);
+    mydelete(evwait_ready);
+}
+
+static void *v4l2poll_handler(void *arg)
+{
+    ((cls_v4l2poll *)arg)->handler();
+    return nullptr;
+}
+
+void cls_v4l2poll::handler()
+{
+    #if defined(HAVE_V4L2) && defined(HAVE_SYS_EPOLL_H)
+        struct epoll_event events[16];
+        std::vector<cls_v4l2cam*>::iterator it;
+        sigset_t set;
+        int indx, cnt;
+
+        mythreadname_set("vp", 0, "v4l2poll");
+
+        /* The camera threads handle the signals */
+        sigemptyset(&set);
+        sigaddset(&set, SIGCHLD);
+        sigaddset(&set, SIGALRM);
+        sigaddset(&set, SIGUSR1);
+        sigaddset(&set, SIGTERM);
+        sigaddset(&set, SIGHUP);
+        pthread_sigmask(SIG_BLOCK, &set, nullptr);
+
+        while (handler_stop == false) {
+            cnt = epoll_wait(fd_epoll, events, 16, 1000);
+            if (cnt == -1) {
+                if (errno != EINTR) {
+                    MOTION_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO, _("epoll_wait failed"));
+                    SLEEP(1, 0);
+                }
+                continue;
+            }
+            pthread_mutex_lock(&mutex);
+                for (indx=0; indx<cnt; indx++) {
+                    /* Skip devices removed since the wait returned */
+                    it = std::find(cam_lst.begin(), cam_lst.end()
+                        , (cls_v4l2cam *)events[indx].data.ptr);
+                    if (it == cam_lst.end()) {
+                        continue;
+                    }
+                    if ((*it)->reactor_dequeue() == false) {
+                        epoll_ctl(fd_epoll, EPOLL_CTL_DEL
+                            , fd_lst[(size_t)(it - cam_lst.begin())], nullptr);
+                    }
+                }
+            pthread_mutex_unlock(&mutex);
+        }
+
+        MOTION_LOG(NTC, TYPE_VIDEO, NO_ERRNO, _("Capture reactor closed"));
+    #endif
+    handler_running = false;
+    pthread_exit(NULL);
+}
+
+void cls_v4l2poll::handler_startup()
+{
+    int retcd;
+    pthread_attr_t thread_attr;
+
+    if (handler_running == false) {
+        handler_running = true;
+        handler_stop = false;
+        pthread_attr_init(&thread_attr);
+        pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+        retcd = pthread_create(&handler_thread, &thread_attr, &v4l2poll_handler, this);
+        if (retcd != 0) {
+            MOTION_LOG(WRN, TYPE_VIDEO, NO_ERRNO,_("Unable to start capture reactor thread."));
+            handler_running = false;
+            handler_stop = true;
+        }
+        pthread_attr_destroy(&thread_attr);
+    }
+}
+
+void cls_v4l2poll::handler_shutdown()
+{
+    int waitcnt;
+
+    if (handler_running == true) {
+        handler_stop = true;
+        waitcnt = 0;
+        while ((handler_running == true) && (waitcnt < app->cfg->watchdog_tmo)){
+            SLEEP(1,0)
+            waitcnt++;
+        }
+        if (waitcnt == app->cfg->watchdog_tmo) {
+            MOTION_LOG(ERR, TYPE_VIDEO, NO_ERRNO
+                , _("Normal shutdown of capture reactor failed"));
+        }
+        handler_running = false;
+    }
+}
+
+/* Start waiting on the device.  The thread starts with the first device */
+bool cls_v4l2poll::add(cls_v4l2cam *p_v4l2cam, int fd)
+{
+    #if defined(HAVE_V4L2) && defined(HAVE_SYS_EPOLL_H)
+        struct epoll_event ev;
+
+        if (fd_epoll == -1) {
+            return false;
+        }
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = p_v4l2cam;
+
+        pthread_mutex_lock(&mutex);
+            if (epoll_ctl(fd_epoll, EPOLL_CTL_ADD, fd, &ev) == -1) {
+                pthread_mutex_unlock(&mutex);
+                MOTION_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO
+                    , _("Unable to add device to the capture reactor"));
+                return false;
+            }
+            cam_lst.push_back(p_v4l2cam);
+            fd_lst.push_back(fd);
+        pthread_mutex_unlock(&mutex);
+
+        handler_startup();
+
+        return handler_running;
+    #else
+        (void)p_v4l2cam;
+        (void)fd;
+        return false;
+    #endif
+}
+
+/*
+ * Stop waiting on the device.  Since dispatch holds the mutex, the
+ * reactor is no longer using the camera once this returns.
+ */
+void cls_v4l2poll::remove(cls_v4l2cam *p_v4l2cam, int fd)
+{
+    #if defined(HAVE_V4L2) && defined(HAVE_SYS_EPOLL_H)
+        size_t indx;
+
+        pthread_mutex_lock(&mutex);
+            epoll_ctl(fd_epoll, EPOLL_CTL_DEL, fd, nullptr);
+            for (indx=0; indx<cam_lst.size(); indx++) {
+                if (cam_lst[indx] == p_v4l2cam) {
+                    cam_lst.erase(cam_lst.begin() + (long)indx);
+                    fd_lst.erase(fd_lst.begin() + (long)indx);
+                    break;
+                }
+            }
+        pthread_mutex_unlock(&mutex);
+    #else
+        (void)p_v4l2cam;
+        (void)fd;
+    #endif
+}
+
+cls_v4l2poll::cls_v4l2poll(cls_motapp *p_app)
+{
+    app = p_app;
+    handler_running = false;
+    handler_stop = true;
+    fd_epoll = -1;
+    pthread_mutex_init(&mutex, nullptr);
+    #if defined(HAVE_V4L2) && defined(HAVE_SYS_EPOLL_H)
+        fd_epoll = epoll_create1(EPOLL_CLOEXEC);
+        if (fd_epoll == -1) {
+            MOTION_LOG(ERR, TYPE_VIDEO, SHOW_ERRNO
+                , _("Unable to create the capture reactor"));
+        }
+    #endif
+}
+
+cls_v4l2poll::~cls_v4l2poll()
+{
+    handler_shutdown();
+    if (fd_epoll != -1) {
+        close(fd_epoll);
+    }
+    pthread_mutex_destroy(&mutex);
 }
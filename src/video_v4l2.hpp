@@ -53,6 +53,7 @@ class cls_v4l2cam {
         ~cls_v4l2cam();
         int next(ctx_image_data *img_data);
         void noimage();
+        bool reactor_dequeue();
     private:
         cls_camera *cam;
         cls_convert *convert;
@@ -70,12 +71,21 @@ class cls_v4l2cam {
 
         int     pframe;
         int     reconnect_count;
+        bool    zero_copy;      /* Buffers are swapped with the ring images */
+        bool    reactor;        /* Buffers are dequeued by the cls_v4l2poll thread */
+        bool    ready_valid;    /* ready_buf holds a filled buffer for capture */
+        bool    ready_error;    /* The reactor could not dequeue from the device */
+        int     ready_dropped;  /* Filled buffers replaced by a newer one */
+        pthread_mutex_t mutex_ready;
+        cls_evwait      *evwait_ready;
 
         #ifdef HAVE_V4L2
+            enum v4l2_memory            buf_memory;
             struct v4l2_capability      vidcap;
             struct v4l2_format          vidfmt;
             struct v4l2_requestbuffers  vidreq;
             struct v4l2_buffer          vidbuf;
+            struct v4l2_buffer          ready_buf;
 
             void start_cam();
             void stop_cam();
@@ -101,8 +111,14 @@ class cls_v4l2cam {
             int pixfmt_list();
             void palette_set();
             void set_mmap();
+            void set_userptr();
+            void set_buffers();
+            void set_reactor();
             void set_imgs();
+            int buffer_queue(struct v4l2_buffer *buf);
+            int capture_ready();
             int capture();
+            void set_timestamp(ctx_image_data *img_data);
             void log_types();
             void log_formats();
             void set_fps();
@@ -111,5 +127,34 @@ class cls_v4l2cam {
 
 };
 
+/*
+ * Capture reactor shared by the V4L2 cameras.  A single thread waits
+ * on the descriptors of all the registered devices with epoll and
+ * dequeues each buffer as soon as the driver has filled it.  The
+ * newest buffer is handed to the camera and the camera thread woken.
+ */
+class cls_v4l2poll {
+    public:
+        cls_v4l2poll(cls_motapp *p_app);
+        ~cls_v4l2poll();
+
+        bool add(cls_v4l2cam *p_v4l2cam, int fd);
+        void remove(cls_v4l2cam *p_v4l2cam, int fd);
+
+        bool            handler_stop;
+        bool            handler_running;
+        pthread_t       handler_thread;
+        void            handler();
+
+    private:
+        cls_motapp      *app;
+        int             fd_epoll;
+        pthread_mutex_t mutex;      /* Held while dispatching or changing cam_lst */
+        std::vector<cls_v4l2cam*>   cam_lst;
+        std::vector<int>            fd_lst;     /* Descriptor of each cam_lst entry */
+
+        void handler_startup();
+        void handler_shutdown();
+};
 
 #endif /* _INCLUDE_VIDEO_V4L2_HPP_ */
@@ -971,7 +971,8 @@ void cls_webu_ans::answer_get()
         }
 
     } else if ((uri_cmd1 == "config.json") || (uri_cmd1 == "log") ||
-        (uri_cmd1 == "movies.json") || (uri_cmd1 == "status.json")) {
+        (uri_cmd1 == "movies.json") || (uri_cmd1 == "status.json") ||
+        (uri_cmd1 == "json")) {
         if (webu_json == nullptr) {
             webu_json = new cls_webu_json(this);
         }
@@ -320,5 +320,8 @@ void webu_getimg_main(cls_camera *cam)
         webu_getimg_motion(cam);
         webu_getimg_source(cam);
         webu_getimg_secondary(cam);
+        if (cam->cfg->movie_roi > 0) {
+            cam->roi_get(cam->current_image, cam->stream_roi);
+        }
     pthread_mutex_unlock(&cam->stream.mutex);
 }
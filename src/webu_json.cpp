@@ -26,6 +26,9 @@
 #include "webu_json.hpp"
 #include "dbse.hpp"
 #include "libcam.hpp"
+#include "storage.hpp"
+#include "profile.hpp"
+#include "movie.hpp"
 #include <map>
 
 std::string cls_webu_json::escstr(std::string invar)
@@ -64,6 +67,10 @@ void cls_webu_json::parms_item_detail(cls_config *conf, std::string pNm)
         util_parms_parse(params, pNm, conf->schedule_params);
     } else if (pNm == "cleandir_params") {
         util_parms_parse(params, pNm, conf->cleandir_params);
+    } else if (pNm == "storage_params") {
+        util_parms_parse(params, pNm, conf->storage_params);
+    } else if (pNm == "movie_params") {
+        util_parms_parse(params, pNm, conf->movie_params);
     } else if (pNm == "secondary_params") {
         util_parms_parse(params, pNm, conf->secondary_params);
     } else if (pNm == "webcontrol_actions") {
@@ -381,6 +388,15 @@ void cls_webu_json::movies_list()
             webua->resp_page += ",\"sdev_avg\": \"";
             webua->resp_page += std::to_string(flst[indx2].sdev_avg) + "\"";
 
+            webua->resp_page += ",\"type\": \"";
+            webua->resp_page += escstr(flst[indx2].file_typ) + "\"";
+
+            webua->resp_page += ",\"evt_off\": \"";
+            webua->resp_page += std::to_string(flst[indx2].evt_off) + "\"";
+
+            webua->resp_page += ",\"evt_len\": \"";
+            webua->resp_page += std::to_string(flst[indx2].evt_len) + "\"";
+
             webua->resp_page += "}";
             webua->resp_page += ",";
             indx++;
@@ -476,6 +492,10 @@ void cls_webu_json::status_vars(int indx_cam)
 
     webua->resp_page += ",\"user_pause\":\"" + cam->user_pause +"\"";
 
+    status_frametiming(cam);
+    status_movies(cam);
+    status_storage(cam);
+
     /* Add supportedControls for libcamera capability discovery */
     #ifdef HAVE_LIBCAM
     if (cam->has_libcam()) {
@@ -497,6 +517,79 @@ void cls_webu_json::status_vars(int indx_cam)
     webua->resp_page += "}";
 }
 
+void cls_webu_json::status_frametiming(cls_camera *cam)
+{
+    ctx_frametiming *ft = &cam->frame_timing;
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "%.2f", ft->fps);
+    webua->resp_page += ",\"frametiming\":{";
+    webua->resp_page += "\"policy\":\"" + cam->cfg->framerate_policy + "\"";
+    webua->resp_page += ",\"fps\":" + std::string(buf);
+    webua->resp_page += ",\"frames\":" + std::to_string(ft->frames);
+    webua->resp_page += ",\"skipped\":" + std::to_string(ft->skipped);
+    webua->resp_page += ",\"late_max_us\":" + std::to_string(ft->late_max);
+    webua->resp_page += ",\"late_hist\":{";
+    webua->resp_page += "\"ontime\":" + std::to_string(ft->late[0]);
+    webua->resp_page += ",\"lt5ms\":" + std::to_string(ft->late[1]);
+    webua->resp_page += ",\"lt10ms\":" + std::to_string(ft->late[2]);
+    webua->resp_page += ",\"lt50ms\":" + std::to_string(ft->late[3]);
+    webua->resp_page += ",\"ge50ms\":" + std::to_string(ft->late[4]);
+    webua->resp_page += "}}";
+}
+
+void cls_webu_json::status_movie(cls_movie *movie, std::string nm)
+{
+    pthread_mutex_lock(&movie->mutex_queue);
+        webua->resp_page += "\"" + nm + "\":{";
+        webua->resp_page += "\"running\":";
+        webua->resp_page += (movie->is_running ? "true" : "false");
+        webua->resp_page += ",\"queue\":" + std::to_string(movie->queue_cnt);
+        webua->resp_page += ",\"queue_max\":" + std::to_string(movie->queue_max);
+        webua->resp_page += ",\"queue_peak\":" + std::to_string(movie->queue_peak);
+        webua->resp_page += ",\"dropped\":" + std::to_string(movie->queue_dropped);
+        webua->resp_page += ",\"preroll_bytes\":" + std::to_string(movie->preroll_bytes);
+        webua->resp_page += "}";
+    pthread_mutex_unlock(&movie->mutex_queue);
+}
+
+void cls_webu_json::status_movies(cls_camera *cam)
+{
+    if ((cam->movie_norm == nullptr) || (cam->movie_motion == nullptr) ||
+        (cam->movie_timelapse == nullptr) || (cam->movie_extpipe == nullptr)) {
+        return;
+    }
+    webua->resp_page += ",\"movies\":{";
+    status_movie(cam->movie_norm, "norm");
+    webua->resp_page += ",";
+    status_movie(cam->movie_motion, "motion");
+    webua->resp_page += ",";
+    status_movie(cam->movie_timelapse, "timelapse");
+    webua->resp_page += ",";
+    status_movie(cam->movie_extpipe, "extpipe");
+    webua->resp_page += "}";
+}
+
+void cls_webu_json::status_storage(cls_camera *cam)
+{
+    cls_storage *strg = cam->storage;
+
+    pthread_mutex_lock(&strg->mutex_storage);
+        webua->resp_page += ",\"storage\":{";
+        webua->resp_page += "\"enabled\":";
+        webua->resp_page += (strg->enabled ? "true" : "false");
+        webua->resp_page += ",\"bytes_written\":" + std::to_string(strg->bytes_total);
+        webua->resp_page += ",\"movie_max\":" + std::to_string(strg->bytes_movie_max);
+        webua->resp_page += ",\"rate_bps\":" + std::to_string(strg->rate_bps);
+        webua->resp_page += ",\"fs_total\":" + std::to_string(strg->fs_total);
+        webua->resp_page += ",\"fs_free\":" + std::to_string(strg->fs_free);
+        webua->resp_page += ",\"headroom\":" + std::to_string(strg->headroom);
+        webua->resp_page += ",\"evicted_files\":" + std::to_string(strg->evict_files);
+        webua->resp_page += ",\"evicted_bytes\":" + std::to_string(strg->evict_bytes);
+        webua->resp_page += "}";
+    pthread_mutex_unlock(&strg->mutex_storage);
+}
+
 void cls_webu_json::status()
 {
     int indx_cam;
@@ -517,6 +610,52 @@ void cls_webu_json::status()
     webua->resp_page += "}";
 }
 
+void cls_webu_json::profile_cam(cls_camera *cam)
+{
+    cls_profile *prof = cam->profile;
+    int stage;
+
+    webua->resp_page += "{";
+    for (stage=0; stage<PROF_STAGE_CNT; stage++) {
+        if (stage != 0) {
+            webua->resp_page += ",";
+        }
+        webua->resp_page += "\"" + std::string(cls_profile::stage_name(stage)) + "\":{";
+        webua->resp_page += "\"count\":" + std::to_string(prof->count(stage));
+        webua->resp_page += ",\"p50_us\":" + std::to_string(prof->percentile(stage, 50));
+        webua->resp_page += ",\"p99_us\":" + std::to_string(prof->percentile(stage, 99));
+        webua->resp_page += ",\"max_us\":" + std::to_string(prof->max(stage));
+        webua->resp_page += "}";
+    }
+    webua->resp_page += "}";
+}
+
+/* Stage latencies of the requested camera or of all cameras */
+void cls_webu_json::profile()
+{
+    int indx_cam;
+    bool frst;
+
+    webua->resp_type = WEBUI_RESP_JSON;
+
+    webua->resp_page += "{";
+    frst = true;
+    for (indx_cam=0; indx_cam<app->cam_cnt; indx_cam++) {
+        if ((webua->cam != nullptr) &&
+            (webua->cam != app->cam_list[indx_cam])) {
+            continue;
+        }
+        if (frst == false) {
+            webua->resp_page += ",";
+        }
+        frst = false;
+        webua->resp_page += "\"cam" +
+            std::to_string(app->cam_list[indx_cam]->cfg->device_id) + "\":";
+        profile_cam(app->cam_list[indx_cam]);
+    }
+    webua->resp_page += "}";
+}
+
 void cls_webu_json::loghistory()
 {
     int indx, cnt;
@@ -809,6 +948,9 @@ void cls_webu_json::main()
             status();
         } else if (webua->uri_cmd1 == "log") {
             loghistory();
+        } else if ((webua->uri_cmd1 == "json") &&
+            (webua->uri_cmd2 == "profile")) {
+            profile();
         } else {
             webua->bad_request();
             pthread_mutex_unlock(&app->mutex_post);
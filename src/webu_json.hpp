@@ -40,8 +40,14 @@
             void movies_list();
             void movies();
             void status_vars(int indx_cam);
+            void status_frametiming(cls_camera *cam);
+            void status_movie(cls_movie *movie, std::string nm);
+            void status_movies(cls_camera *cam);
+            void status_storage(cls_camera *cam);
             void status();
             void loghistory();
+            void profile_cam(cls_camera *cam);
+            void profile();
             std::string escstr(std::string invar);
             void parms_item_detail(cls_config *conf, std::string pNm);
 
@@ -27,6 +27,8 @@
 #include "webu_ans.hpp"
 #include "webu_stream.hpp"
 #include "webu_mpegts.hpp"
+#include "profile.hpp"
+#include "encbench.hpp"
 
 /****** Callback functions for MHD ****************************************/
 
@@ -81,6 +83,11 @@ int cls_webu_mpegts::pic_send(unsigned char *img)
     picture->pts = av_rescale_q(pts_interval
         ,av_make_q(1,1000000L), ctx_codec->time_base);
 
+    if (webua->device_id > 0) {
+        myframe_roi(picture, roi, webua->cam->imgs.width
+            , webua->cam->imgs.height, webua->cam->cfg->movie_roi);
+    }
+
     retcd = avcodec_send_frame(ctx_codec, picture);
     if (retcd < 0 ) {
         av_strerror(retcd, errstr, sizeof(errstr));
@@ -145,12 +152,18 @@ int cls_webu_mpegts::getimg()
     struct timespec curr_ts;
     unsigned char *img_data;
     int img_sz;
+    int64_t prof_ts;
 
     if (webus->check_finish() == true) {
         resetpos();
         return 0;
     }
 
+    prof_ts = 0;
+    if (webua->cam != nullptr) {
+        prof_ts = webua->cam->profile->now();
+    }
+
     clock_gettime(CLOCK_REALTIME, &curr_ts);
 
     memset(webus->resp_image, '\0', webus->resp_size);
@@ -180,6 +193,7 @@ int cls_webu_mpegts::getimg()
                 memcpy(img_data, strm->img_data, (uint)img_sz);
                 strm->consumed = true;
             }
+            roi = webua->cam->stream_roi;
         pthread_mutex_unlock(&webua->cam->stream.mutex);
     } else {
         if (webua->cnct_type == WEBUI_CNCT_TS_FULL) {
@@ -218,6 +232,10 @@ int cls_webu_mpegts::getimg()
         return -1;
     }
 
+    if (webua->cam != nullptr) {
+        webua->cam->profile->record(PROF_STREAM, prof_ts);
+    }
+
     return 0;
 }
 
@@ -300,6 +318,7 @@ int cls_webu_mpegts::open_mpegts()
     const AVCodec   *codec;
     AVDictionary    *opts;
     size_t          aviobuf_sz;
+    std::string     enc_nm, enc_preset;
 
     opts = NULL;
     webus->stream_fps = 30;
@@ -311,7 +330,15 @@ int cls_webu_mpegts::open_mpegts()
     fmtctx->oformat = av_guess_format("mpegts", NULL, NULL);
     fmtctx->video_codec_id = AV_CODEC_ID_H264;
 
-    codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+    codec = nullptr;
+    enc_preset = "superfast";
+    if (app->encbench->get(AV_CODEC_ID_H264, enc_nm, enc_preset)) {
+        codec = avcodec_find_encoder_by_name(enc_nm.c_str());
+    }
+    if (codec == nullptr) {
+        codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+        enc_preset = "superfast";
+    }
     strm = avformat_new_stream(fmtctx, codec);
 
     if (webua->device_id > 0) {
@@ -349,7 +376,9 @@ int cls_webu_mpegts::open_mpegts()
     av_opt_set(ctx_codec->priv_data, "profile", "main", 0);
     av_opt_set(ctx_codec->priv_data, "crf", "22", 0);
     av_opt_set(ctx_codec->priv_data, "tune", "zerolatency", 0);
-    av_opt_set(ctx_codec->priv_data, "preset", "superfast",0);
+    if (enc_preset != "") {
+        av_opt_set(ctx_codec->priv_data, "preset", enc_preset.c_str(),0);
+    }
     av_dict_set(&opts, "movflags", "empty_moov", 0);
 
     retcd = avcodec_open2(ctx_codec, codec, &opts);
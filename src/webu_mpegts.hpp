@@ -39,6 +39,7 @@
             size_t          stream_pos;     /* Stream position of sent image */
             struct timespec start_time;     /* Start time of the stream*/
             struct timespec st_mono_time;
+            std::vector<ctx_coord> roi;     /* Boxes of the image in camera pixels */
 
             int pic_send(unsigned char *img);
             int pic_get();
@@ -70,6 +70,7 @@ void cls_webu_post::cam_add()
     maxcnt = 100;
 
     app->cam_add = true;
+    app->wake();
     indx = 0;
     while ((app->cam_add == true) && (indx < maxcnt)) {
         SLEEP(0, 50000000)
@@ -105,6 +106,7 @@ void cls_webu_post::cam_delete()
     MOTION_LOG(INF, TYPE_ALL, NO_ERRNO, "Deleting camera.");
 
     app->cam_delete = webua->camindx;
+    app->wake();
 
     maxcnt = 100;
     indx = 0;
@@ -673,6 +675,7 @@ void cls_webu_post::config()
             }
         }
     }
+    app->wake();
 
 }
 
@@ -29,6 +29,7 @@
 #include "webu_mpegts.hpp"
 #include "alg_sec.hpp"
 #include "jpegutils.hpp"
+#include "profile.hpp"
 
 static ssize_t webu_mjpeg_response (void *cls, uint64_t pos, char *buf, size_t max)
 {
@@ -282,6 +283,7 @@ void cls_webu_stream::mjpeg_one_img()
 ssize_t cls_webu_stream::mjpeg_response (char *buf, size_t max)
 {
     size_t sent_bytes;
+    int64_t prof_ts;
 
     if (check_finish()) {
         return -1;
@@ -296,8 +298,10 @@ ssize_t cls_webu_stream::mjpeg_response (char *buf, size_t max)
 
         if (webua->device_id == 0) {
             mjpeg_all_img();
-        } else {
+        } else if (webua->cam != nullptr) {
+            prof_ts = webua->cam->profile->now();
             mjpeg_one_img();
+            webua->cam->profile->record(PROF_STREAM, prof_ts);
         }
 
         if (resp_used == 0) {
@@ -357,6 +361,7 @@ void cls_webu_stream::all_cnct()
     pthread_mutex_lock(&app->allcam->stream.mutex);
         strm->all_cnct++;
     pthread_mutex_unlock(&app->allcam->stream.mutex);
+    app->allcam->wake();
 
 }
 